@@ -25,6 +25,8 @@ private:
         matchPage.handleClick(
           event->getIf<sf::Event::MouseButtonPressed>()
         );
+      } else if(event->is<sf::Event::KeyPressed>()) {
+        matchPage.handleKey(event->getIf<sf::Event::KeyPressed>());
       }
     }
   }
@@ -0,0 +1,91 @@
+#ifndef CHESS_API_H
+#define CHESS_API_H
+
+/*
+  C interface to the engine, for linking it into other programs (make lib
+  builds libchess.a and libchess.so, neither needs SFML).
+
+  An engine handle owns its transposition table, search trees and helper
+  threads. Calls on one handle must not overlap; separate handles may be
+  used from separate threads. Strings go in and out as FEN and coordinate
+  notation (e2e4, e7e8q). Scores are in pawns from white's view: mates are
+  +-1000, endgame table results +-(500 - plies to mate / 10).
+
+  Functions return CHESS_OK or a negative error code, with a message in
+  chess_last_error(). Structures only grow in a new CHESS_API_VERSION.
+*/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CHESS_API __attribute__((visibility("default")))
+#else
+#define CHESS_API
+#endif
+
+#define CHESS_API_VERSION 1
+
+#define CHESS_OK 0
+#define CHESS_INVALID_ARGUMENT -1
+#define CHESS_INVALID_POSITION -2
+#define CHESS_ILLEGAL_MOVE -3
+#define CHESS_LOAD_FAILED -4
+#define CHESS_INTERNAL_ERROR -5
+
+typedef struct chess_engine chess_engine;
+
+typedef struct chess_limits {
+  int depth;         /* Deepest iteration, 0 for no limit */
+  double move_time;  /* Seconds, 0 if unset */
+  uint64_t nodes;    /* Nodes, 0 if unset; checked every 1024 nodes */
+} chess_limits;
+
+typedef struct chess_result {
+  int status;        /* CHESS_OK, or why this position has no result */
+  char move[8];      /* Best move, empty for a static evaluation or no legal move */
+  double score;
+  int depth;         /* Last completed iteration, 0 when not searched */
+  uint64_t nodes;
+  double seconds;
+} chess_result;
+
+CHESS_API int chess_api_version(void);
+
+/* hash_mb and tree_mb of 0 take the defaults (64 and 256). NULL on failure. */
+CHESS_API chess_engine *chess_engine_new(int hash_mb, int tree_mb);
+CHESS_API void chess_engine_free(chess_engine *engine);
+CHESS_API const char *chess_last_error(const chess_engine *engine);
+
+CHESS_API int chess_set_threads(chess_engine *engine, int threads);
+CHESS_API int chess_set_seed(chess_engine *engine, uint32_t seed);
+
+/* NULL path turns each off. Network: see Nnue.hpp, book: Polyglot, tables: a directory of *.tb. */
+CHESS_API int chess_load_network(chess_engine *engine, const char *path);
+CHESS_API int chess_load_book(chess_engine *engine, const char *path);
+CHESS_API int chess_load_tablebase(chess_engine *engine, const char *dir);
+
+/* fen NULL for the starting position, then moves[0..move_count) played from it. */
+CHESS_API int chess_set_position(chess_engine *engine, const char *fen, const char *const *moves, int move_count);
+
+/* Searches the current position. Limits may be combined; the first reached stops the search. */
+CHESS_API int chess_search(chess_engine *engine, const chess_limits *limits, chess_result *result);
+
+/*
+  One result per FEN. With limits NULL each position gets its static
+  evaluation, otherwise a search with those limits; the TT is kept across
+  the batch. The position set with chess_set_position stays current.
+  Returns CHESS_INVALID_POSITION when any FEN was rejected (see each
+  result's status), CHESS_OK otherwise.
+*/
+CHESS_API int chess_evaluate_batch(chess_engine *engine, const char *const *fens, int count,
+  const chess_limits *limits, chess_result *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
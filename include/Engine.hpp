@@ -1,23 +1,30 @@
 #ifndef ENGINE_HPP
 #define ENGINE_HPP
 
+#include <atomic>
+#include <future>
 #include <memory>
+#include <thread>
 #include <vector>
 #include <chrono>
 #include <random>
 #include <algorithm>
 
 #include <Game.hpp>
+#include <MoveOrdering.hpp>
+#include <NodeArena.hpp>
+#include <OpeningBook.hpp>
+#include <Tablebase.hpp>
+#include <TranspositionTable.hpp>
 
-std::mt19937 rng(std::chrono::steady_clock::now().time_since_epoch().count());
+inline double INF = 1e8;
+inline double DELTA_MARGIN = 2.0; // Quiescence: pawns a capture may gain beyond its victim's value
+inline double NULL_WINDOW = 0.001; // PVS scout width, wider than cmp's epsilon
+inline double ASPIRATION_WINDOW = 0.5; // Half width of the first root window, in pawns
+inline double ASPIRATION_MAX = 8.0; // Beyond this the root goes back to the full window
+inline double FUTILITY_MARGIN[3] = {0.0, 1.0, 3.0}; // By remaining depth, in pawns
 
-typedef std::pair<int, int> i2;
-typedef std::pair<i2, i2> i4;
-typedef std::pair<i4, int> i5;
-
-double INF = 1e8;
-
-int cmp(double a, double b) {
+inline int cmp(double a, double b) {
   double eps = 0.0001;
 
   if(std::abs(a - b) < eps) return 0;
@@ -25,212 +32,1106 @@ int cmp(double a, double b) {
   return 1;
 }
 
-bool max_cmp(std::pair<double, int> a, std::pair<double, int> b) {
-  return cmp(a.first, b.first) == 1;
-}
+struct SearchResult {
+  Move move;
+  double score;
+  int depth;
+  uint64_t nodes;
+  double seconds;
+};
 
-bool min_cmp(std::pair<double, int> a, std::pair<double, int> b) {
-  return cmp(a.first, b.first) == -1;
-}
+struct SearchLimits {
+  int depth = 64;          // Deepest iteration
+  double move_time = 0.0;  // Seconds for this move, 0 if unset
+  double remaining = 0.0;  // Clock of the side to move, 0 if unset
+  double increment = 0.0;
+  int moves_to_go = 0;     // Moves to the next time control, 0 for sudden death
+  uint64_t nodes = 0;      // Nodes of the main thread, 0 if unset
+};
+
+struct SearchOptions {
+  // Selective search, each can be turned off to measure it (see bench)
+  bool null_move = true;
+  bool late_move_reductions = true;
+  bool futility = true;
+};
+
+struct PruningStats {
+  uint64_t null_tries = 0;
+  uint64_t null_cutoffs = 0;
+  uint64_t reductions = 0;
+  uint64_t reduction_researches = 0; // Reduced moves that had to go full depth after all
+  uint64_t futile = 0; // Moves skipped by futility pruning
+  uint64_t tb_hits = 0; // Positions scored by the endgame tables instead of searched
+
+  PruningStats &operator+=(const PruningStats &o) {
+    null_tries += o.null_tries;
+    null_cutoffs += o.null_cutoffs;
+    reductions += o.reductions;
+    reduction_researches += o.reduction_researches;
+    futile += o.futile;
+    tb_hits += o.tb_hits;
+    return *this;
+  }
+};
+
+struct SearchProgress {
+  // Written by the search, readable from any thread while it runs
+  std::atomic<bool> stop{false};
+  std::atomic<int> depth{0};
+  std::atomic<uint64_t> nodes{0};
+  std::atomic<Move> best_move{MOVE_NONE};
+  std::atomic<double> score{0.0};
+  std::atomic<double> time_limit{0.0}; // Hard limit in seconds, 0 if none
+
+  void reset() {
+    stop = false;
+    depth = 0;
+    nodes = 0;
+    best_move = MOVE_NONE;
+    score = 0.0;
+    time_limit = 0.0;
+  }
+};
+
+struct SearchContext {
+  TranspositionTable *tt;
+  std::mt19937 *rng;
+  SearchProgress *progress;
+  const EndgameTables *tablebase = nullptr;
+  TTStats tt_stats;
+  MoveOrdering ordering;
+  SearchOptions options;
+  PruningStats pruning;
+  int null_ply = -1; // Ply right after a null move, which may not pass again
+  uint64_t nodes = 0;
+  int researches = 0; // Root searches repeated after leaving the aspiration window
+  double score = 0.0;
+  bool verbose = false;
+
+  // Lazy SMP helpers start at a staggered depth and may stop anywhere
+  bool helper = false;
+  int first_depth = 1;
+
+  // Once interruptible, explore gives up at the deadline or on progress->stop
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point deadline;
+  double soft_time = 0.0; // No new iteration starts after this many seconds
+  uint64_t node_limit = 0; // 0 if none
+  bool has_deadline = false;
+  bool interruptible = false;
+  bool stopped = false;
+
+  std::vector<SearchResult> iterations; // One per completed depth
+
+  double elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+};
 
-class EngineNode {
+/*
+  The search tree, kept across moves. Its nodes live in a NodeArena; line
+  holds the nodes of the moves played since the arena root, so the last one
+  is the current position. Nodes the arena has no room for are searched
+  straight from the move generator and not kept.
+  reroot() moves the current position's subtree into a new arena and drops
+  the rest.
+*/
+class EngineTree {
 private:
-  double score;
-  int level;
-  int next_line;
-  std::vector<std::unique_ptr<EngineNode>> lines;
-  std::vector<std::pair<double, int>> sorted_ptr;
+  NodeArena arena;
+  int budget_mb;
+  std::vector<NodeIndex> line;
+  std::vector<NodeArena::Row> scratch; // Rows of the block being reordered
+  std::vector<int> keys; // Ordering keys of the block or list being sorted
+  std::deque<std::vector<Move>> off_tree; // Per ply, the ordered moves of nodes outside the arena
 
-  void createNextLines(Game& game) {
-    const auto& moves = game.getAllMoves();
+  void loadChildren(NodeIndex node) {
+    int first = arena.firstChild(node);
+    scratch.resize(arena.childCount(node));
+    for(int i=0;i<scratch.size();i++) scratch[i] = arena.row(first + i);
+  }
 
-    bool isWhiteTurn = game.isWhiteTurn();
+  void storeChildren(NodeIndex node) {
+    int first = arena.firstChild(node);
+    for(int i=0;i<scratch.size();i++) arena.setRow(first + i, scratch[i]);
+  }
 
-    for(int i=0;i<moves.size();i++) {
-      const auto &move = moves[i];
-      if(game.isPawnPromotion(move.first, move.second)) {
-        for(int i=0;i<4;i++) {
-          lines.push_back(std::make_unique<EngineNode>(std::make_pair(move, i), level));
-        }
-      } else {
-        lines.push_back(std::make_unique<EngineNode>(std::make_pair(move, -1), level + 1));
-      }
+  void createNextLines(Game& game, NodeIndex node, std::mt19937 &rng) {
+    if(!arena.expand(node, game.getAllMoves())) return; // Over budget
 
-      sorted_ptr.push_back({0.0, i});
-    }
-  
-    std::shuffle(sorted_ptr.begin(), sorted_ptr.end(), rng);
+    loadChildren(node);
+    std::shuffle(scratch.begin(), scratch.end(), rng);
+    storeChildren(node);
   }
 
-  bool isLinesMissing(const Game& game) const {
+  bool isLinesMissing(Game& game, NodeIndex node) const {
+    if(node == NO_NODE) return false;
     if(game.isDraw() || game.isCheckMate()) return false;
-    return lines.size() == 0;
+    return arena.childCount(node) == 0;
+  }
+
+  template<class T>
+  void sortByKey(std::vector<T> &items) {
+    // Insertion sort, highest key first: lists are short and ties keep their order
+    for(int i=1;i<items.size();i++) {
+      int k = keys[i];
+      T item = items[i];
+      int j = i - 1;
+      for(;j>=0 && keys[j] < k;j--) {
+        keys[j + 1] = keys[j];
+        items[j + 1] = items[j];
+      }
+      keys[j + 1] = k;
+      items[j + 1] = item;
+    }
+  }
+
+  void orderChildren(Game &game, NodeIndex node, Move hash_move, int ply, SearchContext &ctx) {
+    loadChildren(node);
+    keys.resize(scratch.size());
+    for(int i=0;i<scratch.size();i++) keys[i] = ctx.ordering.key(game, scratch[i].move, hash_move, ply);
+    sortByKey(scratch);
+    storeChildren(node);
+  }
+
+  const std::vector<Move> &orderMoves(Game &game, Move hash_move, int ply, SearchContext &ctx) {
+    if(off_tree.size() <= ply) off_tree.resize(ply + 1);
+    std::vector<Move> &list = off_tree[ply];
+    list = game.getAllMoves();
+    keys.resize(list.size());
+    for(int i=0;i<list.size();i++) keys[i] = ctx.ordering.key(game, list[i], hash_move, ply);
+    sortByKey(list);
+    return list;
+  }
+
+  void storeScore(SearchContext &ctx, uint64_t key, int deep, double sc, double alpha, double beta, Move best_move) {
+    Bound bound = BOUND_EXACT;
+    if(cmp(sc, alpha) != 1) bound = BOUND_UPPER;
+    else if(cmp(sc, beta) != -1) bound = BOUND_LOWER;
+
+    ctx.tt->store(key, deep, bound, sc, best_move, ctx.tt_stats);
+  }
+
+  NodeIndex current() const {
+    return line.empty() ? 0 : line.back();
   }
 
 public:
-  i5 move;
+  EngineTree(int size_mb = 64) : arena(size_mb), budget_mb(size_mb) {}
 
-  EngineNode(i5 move, int level) {
-    this->move = move;
-    this->level = level;
-    score = 0.0;
-    next_line = -1;
+  void setBudget(int size_mb) {
+    // Only the root is kept, the line played to it is lost
+    Move last = lastMove();
+    budget_mb = size_mb;
+    arena.setBudget(size_mb);
+    reset(last);
   }
 
-  void setScore(double sc) {
-    score = sc;
+  void reset(Move last = MOVE_NONE) {
+    // last: the move that led to the new root, if any
+    arena.reset();
+    arena.setRow(0, {last, 0.0, NO_NODE, 0});
+    line.clear();
   }
 
-  double getScore() const {
-    return score;
+  Move lastMove() const {
+    return arena.move(current());
   }
 
-  double explore(Game& game, int deep, double alpha, double beta, int &cnt) {
-    cnt++;
-    score = game.getScore();
+  uint64_t size() const {
+    return arena.size();
+  }
 
-    if(deep <= 0) return score;
-    if(game.isDraw() || game.isCheckMate()) return score;
-    if(isLinesMissing(game)) createNextLines(game);
+  uint64_t capacity() const {
+    return arena.capacity();
+  }
+
+  bool countNode(SearchContext &ctx) {
+    // True once the search has to give up
+    ctx.nodes++;
+    if((ctx.nodes & 1023) == 0) {
+      ctx.progress->nodes.store(ctx.nodes, std::memory_order_relaxed);
+      if(ctx.interruptible && (ctx.progress->stop.load(std::memory_order_relaxed)
+        || (ctx.node_limit > 0 && ctx.nodes >= ctx.node_limit)
+        || (ctx.has_deadline && std::chrono::steady_clock::now() >= ctx.deadline))) ctx.stopped = true;
+    }
+    return ctx.stopped;
+  }
+
+  bool probeTablebase(Game &game, double &score, SearchContext &ctx) {
+    // Within the tables the result is exact, nothing below needs searching
+    if(ctx.tablebase == nullptr || game.getPieceCount() > ctx.tablebase->maxMen()) return false;
+    if(!ctx.tablebase->probe(game, score)) return false;
+    ctx.pruning.tb_hits++;
+    return true;
+  }
+
+  const std::vector<Move> &orderCaptures(Game &game, bool evasions, int ply, SearchContext &ctx) {
+    // Captures and promotions, or every move when in check, best first
+    if(off_tree.size() <= ply) off_tree.resize(ply + 1);
+    std::vector<Move> &list = off_tree[ply];
+    list.clear();
+    for(Move m: game.getAllMoves()) {
+      if(evasions || !ctx.ordering.isQuiet(game, m)) list.push_back(m);
+    }
+    keys.resize(list.size());
+    for(int i=0;i<list.size();i++) keys[i] = ctx.ordering.key(game, list[i], MOVE_NONE, ply);
+    sortByKey(list);
+    return list;
+  }
+
+  double quiesce(Game &game, double alpha, double beta, int ply, SearchContext &ctx) {
+    /*
+      Past the nominal depth only captures and promotions are searched, until
+      the position is quiet. The side to move may stand pat on the material
+      instead; in check it has to search every evasion. A capture that could
+      not reach alpha even winning its victim plus DELTA_MARGIN is skipped.
+    */
+    if(countNode(ctx)) return 0.0;
+    if(game.isDraw() || game.isCheckMate()) return game.getScore();
+    double tb_score;
+    if(probeTablebase(game, tb_score, ctx)) return tb_score;
 
-    double first_assign = true;
     bool whiteTurn = game.isWhiteTurn();
+    bool check = game.isOnCheck();
+    double stand_pat = game.getScore();
+    if(ply >= MoveOrdering::MAX_PLY) return stand_pat;
 
-    score = (game.isWhiteTurn() ? -INF: INF);
-    int break_i = sorted_ptr.size();
-  
-    double curr_game_score = game.getScore();
+    double best = (whiteTurn ? -INF : INF);
+    if(!check) {
+      best = stand_pat;
+      if(whiteTurn ? cmp(best, beta) != -1 : cmp(best, alpha) != 1) return best;
+      if(whiteTurn) alpha = std::max(alpha, best);
+      else beta = std::min(beta, best);
+    }
 
-    for(int i=0;i<sorted_ptr.size();i++) {
-      int ptr = sorted_ptr[i].second;
-      const auto &line = lines[ptr];
+    for(Move m: orderCaptures(game, check, ply, ctx)) {
+      if(!check) {
+        double gain = ctx.ordering.gain(game, m) + DELTA_MARGIN;
+        if(whiteTurn ? cmp(stand_pat + gain, alpha) != 1 : cmp(stand_pat - gain, beta) != -1) continue;
+      }
+
+      game.doAction(m);
+      double sc = quiesce(game, alpha, beta, ply+1, ctx);
+      game.undoAction();
+      if(ctx.stopped) return 0.0;
+
+      if(whiteTurn ? sc > best : sc < best) best = sc;
+      if(whiteTurn ? cmp(best, beta) != -1 : cmp(best, alpha) != 1) break;
+      if(whiteTurn) alpha = std::max(alpha, best);
+      else beta = std::min(beta, best);
+    }
+
+    return best;
+  }
+
+  double explore(Game& game, NodeIndex node, int deep, double alpha, double beta, int ply, SearchContext &ctx) {
+    // node is NO_NODE below the point where the arena ran out of room
+    if(deep <= 0) return quiesce(game, alpha, beta, ply, ctx);
+
+    if(countNode(ctx)) return 0.0; // Nothing of an aborted iteration is kept
+    if(game.isDraw() || game.isCheckMate()) return game.getScore();
+    double tb_score;
+    if(ply > 0 && probeTablebase(game, tb_score, ctx)) return tb_score;
+
+    uint64_t key = game.getKey();
+    Move hash_move = MOVE_NONE;
+    TTEntry entry;
+    if(ctx.tt->probe(key, entry, ctx.tt_stats)) {
+      hash_move = entry.move;
+      // The root always searches, its move ordering is what getNextMove reads
+      if(ply > 0 && entry.depth >= deep) {
+        Bound bound = entry.bound();
+        if(bound == BOUND_EXACT
+          || (bound == BOUND_LOWER && cmp(entry.score, beta) != -1)
+          || (bound == BOUND_UPPER && cmp(entry.score, alpha) != 1)) {
+          return entry.score;
+        }
+      }
+    }
+
+    bool whiteTurn = game.isWhiteTurn();
+    bool check = game.isOnCheck();
+    bool pv = (beta - alpha > NULL_WINDOW * 2); // Scouts search a null window
+    double static_score = game.getScore();
+
+    /*
+      Null move: let the opponent move twice. If a shallower search still
+      fails high for us, the real moves will too. Not in check, not right
+      after another null move, and only with pieces besides pawns, whose
+      positions are the ones where passing could be best (zugzwang).
+    */
+    if(ctx.options.null_move && !pv && !check && ply > 0 && ply != ctx.null_ply && deep >= 3
+      && game.hasPieces(whiteTurn) && (whiteTurn ? cmp(static_score, beta) != -1 : cmp(static_score, alpha) != 1)) {
+      int reduction = (deep >= 6 ? 3 : 2);
+      int null_ply = ctx.null_ply;
+      ctx.null_ply = ply + 1;
+      ctx.pruning.null_tries++;
+
+      game.doNullMove();
+      double sc;
+      if(whiteTurn) sc = explore(game, NO_NODE, deep-1-reduction, beta - NULL_WINDOW, beta, ply+1, ctx);
+      else sc = explore(game, NO_NODE, deep-1-reduction, alpha, alpha + NULL_WINDOW, ply+1, ctx);
+      game.undoAction();
+      ctx.null_ply = null_ply;
+      if(ctx.stopped) return 0.0;
+
+      if(whiteTurn ? cmp(sc, beta) != -1 : cmp(sc, alpha) != 1) {
+        ctx.pruning.null_cutoffs++;
+        // A mate found after passing is not a real one
+        if(cmp(std::abs(sc), 1000.0) != -1) sc = (whiteTurn ? beta : alpha);
+        return sc;
+      }
+    }
+
+    // Frontier nodes far below the window only search moves that change the material or give check
+    bool futile = false;
+    double futility_bound = 0.0;
+    if(ctx.options.futility && !pv && !check && deep <= 2) {
+      futility_bound = (whiteTurn ? static_score + FUTILITY_MARGIN[deep] : static_score - FUTILITY_MARGIN[deep]);
+      futile = (whiteTurn ? cmp(futility_bound, alpha) != 1 : cmp(futility_bound, beta) != -1);
+    }
+
+    if(isLinesMissing(game, node)) createNextLines(game, node, *ctx.rng);
+
+    // Moves most likely to cut off first, the tree's rows are reordered in place
+    bool on_tree = (node != NO_NODE && arena.childCount(node) > 0);
+    if(on_tree) orderChildren(game, node, hash_move, ply, ctx);
+    const std::vector<Move> *moves = (on_tree ? nullptr : &orderMoves(game, hash_move, ply, ctx));
+    int count = (on_tree ? arena.childCount(node) : moves->size());
+    NodeIndex first = (on_tree ? arena.firstChild(node) : NO_NODE);
+
+    double alpha_orig = alpha;
+    double beta_orig = beta;
+    Move best_move = MOVE_NONE;
+
+    double first_assign = true;
+
+    double score = (game.isWhiteTurn() ? -INF: INF);
+
+    /*
+      Principal variation search: the first move gets the full window, the
+      rest a null window just past the best score so far, which only tells
+      whether they beat it. Those that do are searched again with the full
+      window. Scores outside the window are bounds (fail-soft), so a scout
+      that fails high says nothing about beta and is always re-searched.
+
+      Late quiet moves are scouted at a reduced depth first (LMR), and only
+      go to full depth if that scout beats the best score.
+    */
+    for(int i=0;i<count;i++) {
+      NodeIndex child = NO_NODE;
+      Move child_move;
+      if(on_tree) {
+        child = first + i;
+        child_move = arena.move(child);
+      } else {
+        child_move = (*moves)[i];
+      }
   
-      game.doAction(line->move.first.first, line->move.first.second, line->move.second);
+      bool quiet = ctx.ordering.isQuiet(game, child_move);
+      game.doAction(child_move);
+      bool gives_check = (i > 0 && quiet && game.isOnCheck());
+
+      if(futile && i > 0 && quiet && !gives_check) {
+        game.undoAction();
+        ctx.pruning.futile++;
+        score = (whiteTurn ? std::max(score, futility_bound) : std::min(score, futility_bound));
+        continue;
+      }
 
-      double sc = line->explore(game, deep-1, alpha, beta, cnt);
+      int reduction = 0;
+      if(ctx.options.late_move_reductions && i >= 3 && deep >= 3 && ply > 0 && quiet && !check && !gives_check) {
+        reduction = (i >= 6 && deep >= 6 ? 2 : 1);
+        ctx.pruning.reductions++;
+      }
+
+      auto scout = [&](int d) {
+        if(whiteTurn) return explore(game, child, d, alpha, alpha + NULL_WINDOW, ply+1, ctx);
+        return explore(game, child, d, beta - NULL_WINDOW, beta, ply+1, ctx);
+      };
 
-      // Preventing get less captures on the last level
-      if(deep == 1 && cmp(curr_game_score, sc) != 0) sc += -game.getCellScore(move.first.second.first, move.first.second.second);
+      double sc;
+      if(i == 0) {
+        sc = explore(game, child, deep-1, alpha, beta, ply+1, ctx);
+      } else {
+        sc = scout(deep-1-reduction);
+        bool beats = (whiteTurn ? cmp(sc, alpha) == 1 : cmp(sc, beta) == -1);
+        if(beats && reduction > 0 && !ctx.stopped) {
+          ctx.pruning.reduction_researches++;
+          sc = scout(deep-1);
+          beats = (whiteTurn ? cmp(sc, alpha) == 1 : cmp(sc, beta) == -1);
+        }
+        if(beats && !ctx.stopped) sc = explore(game, child, deep-1, alpha, beta, ply+1, ctx);
+      }
+      if(ctx.stopped) {
+        // Leave the TT as the last full iteration made it
+        game.undoAction();
+        return 0.0;
+      }
 
-      sorted_ptr[i].first = sc;
+      // Only exact scores are kept, the root picks its move among the best of them
+      bool exact = (cmp(sc, alpha) == 1 && cmp(sc, beta) == -1);
+      if(on_tree) arena.setOrder(child, exact ? sc : (whiteTurn ? -INF : INF));
 
       game.undoAction(); // Rollback
 
-      if(first_assign) {
+      if(first_assign || (whiteTurn && sc > score) || (!whiteTurn && sc < score)) {
         score = sc;
+        best_move = child_move;
         first_assign = false;
-      } else if(whiteTurn) {
-        score = std::max(score, sc);
-      } else {
-        score = std::min(score, sc);
       }
 
       // Alpha-beta prunning (cutoff)
-      if(whiteTurn) {
-        if(cmp(score, beta) != -1) {
-          score = 1000.0; // To avoid use this branch as we dont calculate it until the end
-          break_i = i;
-          break;
-        }
-        alpha = std::max(alpha, score);
-      } else {
-        if(cmp(score, alpha) != 1) {
-          score = -1000.0;
-          break_i = i;
-          break;
-        }
-        beta = std::min(beta, score);
+      if(whiteTurn ? cmp(score, beta) != -1 : cmp(score, alpha) != 1) {
+        if(ctx.ordering.isQuiet(game, best_move)) ctx.ordering.cutoff(game, best_move, deep, ply);
+        break;
       }
+      if(whiteTurn) alpha = std::max(alpha, score);
+      else beta = std::min(beta, score);
     }
 
-    for(int i=break_i;i<sorted_ptr.size();i++) {
-      sorted_ptr[i].first = score;
-    }
-
-    // For some reason, sort after is better the before?
-    if(whiteTurn) std::sort(sorted_ptr.begin(), sorted_ptr.end(), max_cmp);
-    else std::sort(sorted_ptr.begin(), sorted_ptr.end(), min_cmp);
+    storeScore(ctx, key, deep, score, alpha_orig, beta_orig, best_move);
 
     return score;
   }
 
-  i5 getNextMove(Game &game, int deep, int &cnt) {
-    if(next_line != -1){
-      i5 m = lines[next_line]->move;
-      game.doAction(m.first.first, m.first.second, m.second);
-      i5 ret = lines[next_line]->getNextMove(game, deep, cnt);
-      game.undoAction();
+  Move getNextMove(Game &game, int deep, SearchContext &ctx) {
+    // game is at the arena root, the played line leads to the current position
+    for(NodeIndex n: line) game.doAction(arena.move(n));
+    NodeIndex root = current();
 
-      return ret;
-    }
+    /*
+      Iterative deepening: each iteration finds the best moves of the last
+      one in the TT, so the best line is searched first.
+      An iteration cut by the deadline or a stop request is thrown away.
+
+      After the first depth the root searches an aspiration window around
+      the last score. When the score falls outside, that side is widened
+      around it, twice as far each time, up to the full window.
+    */
+    std::vector<NodeIndex> goodMoves;
+    for(int d=ctx.first_depth;d<=deep;d++) {
+      ctx.interruptible = (ctx.helper || d > 1); // The main thread always completes depth 1
 
-    double alpha = -INF;
-    double beta = INF;
-    score = explore(game, deep, alpha, beta, cnt);
-    std::cerr << cnt << " nodes generated\n";
-    std::vector<int> goodMoves;
+      bool aspire = (d > ctx.first_depth && cmp(std::abs(ctx.score), 1000.0) == -1);
+      double delta = ASPIRATION_WINDOW;
+      double alpha = (aspire ? ctx.score - delta : -INF);
+      double beta = (aspire ? ctx.score + delta : INF);
+      double score;
+      while(true) {
+        score = explore(game, root, d, alpha, beta, 0, ctx);
+        if(ctx.stopped) break;
 
-    int score_int = score * 10;
+        bool fail_low = (alpha > -INF && cmp(score, alpha) != 1);
+        bool fail_high = (beta < INF && cmp(score, beta) != -1);
+        if(!fail_low && !fail_high) break;
+
+        delta *= 2;
+        if(fail_low) alpha = (delta > ASPIRATION_MAX ? -INF : score - delta);
+        if(fail_high) beta = (delta > ASPIRATION_MAX ? INF : score + delta);
+        ctx.researches++;
+      }
+      if(ctx.stopped) break;
 
-    for(int i=0;i<sorted_ptr.size();i++) {
-      int curr_score_int = sorted_ptr[i].first * 10;
-      if(curr_score_int == score_int) goodMoves.push_back(sorted_ptr[i].second);
+      ctx.score = score;
+      goodMoves.clear();
+
+      int score_int = score * 10;
+
+      NodeIndex first = arena.firstChild(root);
+      for(int i=0;i<arena.childCount(root);i++) {
+        int curr_score_int = arena.order(first + i) * 10;
+        // Orders read back from the TT went through a float, cmp catches the best one
+        if(curr_score_int == score_int || cmp(arena.order(first + i), score) == 0) goodMoves.push_back(first + i);
+      }
+      if(goodMoves.empty()) break; // No legal move at the root
+
+      double elapsed = ctx.elapsed();
+      Move best = arena.move(goodMoves[0]);
+      ctx.iterations.push_back({best, score, d, ctx.nodes, elapsed});
+      ctx.progress->best_move = best;
+      ctx.progress->score = score;
+      ctx.progress->depth = d;
+      if(ctx.verbose) {
+        std::cerr << "depth " << d << " score " << score << " nodes " << ctx.nodes;
+        std::cerr << " time " << elapsed << "s move " << moveToString(best) << "\n";
+      }
+
+      if(arena.childCount(root) == 1) break; // Forced move
+      if(cmp(std::abs(score), 1000.0) != -1) break; // Mate found, the shallowest one comes first
+      if(ctx.soft_time > 0 && elapsed >= ctx.soft_time) break;
+      if(ctx.progress->stop) break;
     }
-    std::cerr << "good moves: " << goodMoves.size() << "\n";
 
-    int pt = std::uniform_int_distribution<int>(0, (int)goodMoves.size() - 1)(rng);
-    int choose = goodMoves[pt];
+    for(int i=0;i<line.size();i++) game.undoAction();
+
+    if(goodMoves.empty()) return MOVE_NONE; // A helper stopped before its first depth
+    int pt = std::uniform_int_distribution<int>(0, (int)goodMoves.size() - 1)(*ctx.rng);
+    NodeIndex choose = goodMoves[pt];
 
-    std::cerr << "future score: " << lines[choose]->score << "\n";
+    if(ctx.verbose) {
+      std::cerr << "good moves: " << goodMoves.size() << "\n";
+      std::cerr << "future score: " << arena.order(choose) << "\n";
+      std::cerr << "tree: " << arena.size() << " of " << arena.capacity() << " nodes\n";
+    }
 
-    return lines[choose]->move;
+    return arena.move(choose);
   }
 
-  void moveDone(Game &game, i5 move) {
-    if(isLinesMissing(game)) createNextLines(game);
+  double searchScore(Game &game, int deep, double alpha, double beta, SearchContext &ctx) {
+    // The current position searched as a child of the root
+    for(NodeIndex n: line) game.doAction(arena.move(n));
+    double sc = explore(game, current(), deep, alpha, beta, 1, ctx);
+    for(int i=0;i<line.size();i++) game.undoAction();
+    return sc;
+  }
 
-    if(next_line != -1) {
-      i5 m = lines[next_line]->move;
-      game.doAction(m.first.first, m.first.second, m.second);
-      lines[next_line]->moveDone(game, move);
-      game.undoAction();
-      return;
-    }
+  void reroot(Game &game) {
+    /*
+      Makes the current position the root: game is moved along the line for
+      good, its subtree is copied breadth first into a new arena (each block
+      stays contiguous and in order) and the old arena, with every sibling
+      of the line, is freed.
+    */
+    PROFILE_SCOPE("reroot");
+    for(NodeIndex n: line) game.doAction(arena.move(n));
+    NodeIndex root = current();
 
-    for(int i=0;i<lines.size();i++) {
-      if(lines[i]->move == move) {
-        next_line = i;
-        break;
+    NodeArena tree(budget_mb);
+    tree.setRow(0, {arena.move(root), 0.0, NO_NODE, 0});
+    std::vector<NodeIndex> origin = {root}; // Old index of each new row
+    std::vector<Move> moves;
+
+    for(NodeIndex to=0;to<tree.size();to++) {
+      NodeIndex from = origin[to];
+      int count = arena.childCount(from);
+      if(count == 0) continue;
+
+      NodeIndex first = arena.firstChild(from);
+      moves.clear();
+      for(int i=0;i<count;i++) moves.push_back(arena.move(first + i));
+      tree.expand(to, moves); // The subtree is never bigger than the old arena
+      for(int i=0;i<count;i++) {
+        tree.setOrder(tree.firstChild(to) + i, arena.order(first + i));
+        origin.push_back(first + i);
       }
     }
 
-    assert(next_line != -1);
+    arena = std::move(tree);
+    line.clear();
+  }
+
+  bool moveDone(Game &game, Move move, std::mt19937 &rng) {
+    // False when the arena has no room for the new position, the tree must be reset
+    for(NodeIndex n: line) game.doAction(arena.move(n));
+    NodeIndex node = current();
+    if(isLinesMissing(game, node)) createNextLines(game, node, rng);
+    for(int i=0;i<line.size();i++) game.undoAction();
+
+    NodeIndex first = arena.firstChild(node);
+    for(int i=0;i<arena.childCount(node);i++) {
+      if(arena.move(first + i) == move) {
+        line.push_back(first + i);
+        return true;
+      }
+    }
+    return false;
   }
 };
 
 class Engine {
 private:
-  std::unique_ptr<EngineNode> root;
+  EngineTree tree;
+  int tree_mb;
   Game game;
+  std::shared_ptr<const Nnue::Network> network;
+  std::shared_ptr<const OpeningBook> book;
+  std::shared_ptr<const EndgameTables> tablebase;
+  TranspositionTable tt;
+  std::mt19937 rng;
+  bool verbose;
+  SearchOptions options;
+  SearchResult last_search;
+  std::vector<SearchResult> last_iterations;
+  PruningStats last_pruning;
 
-public:
+  // Background search, see startSearch and startPonder
+  std::unique_ptr<SearchProgress> progress;
+  std::future<Move> pending;
+  bool pondering;
+  bool pondered; // The next search keeps the TT generation the ponder filled
+
+  // Lazy SMP
+  int threads;
+  std::vector<Move> history; // Moves since game's position, to set up helper games
+
+  struct Helper {
+    Game game;
+    EngineTree tree;
+    std::mt19937 rng;
+    SearchProgress progress;
+    SearchContext ctx;
 
-  Engine() {
-    i5 move = {{{-1, -1}, {-1, -1}}, -1};
-    root = std::make_unique<EngineNode>(move, 0);
+    Helper(int tree_mb): tree(tree_mb) {}
+  };
+  std::vector<std::unique_ptr<Helper>> helpers; // Kept between searches with their trees' memory
+
+  // Rerooting after moveDone, runs while the caller gets on with its turn
+  std::future<void> reroot_job;
+
+  void settle() const {
+    // Everything that reads the tree, game or history waits for the reroot
+    if(reroot_job.valid()) reroot_job.wait();
+  }
+
+  int treeShare() const {
+    // The tree budget is split evenly between the threads
+    return std::max(1, tree_mb / threads);
+  }
+
+  void rebase() {
+    /*
+      Start a new tree at the current position: game catches up with the
+      moves played, and the old tree's memory is reused.
+    */
+    Move last = tree.lastMove();
+    for(Move m: history) game.doAction(m);
+    history.clear();
+    tree.reset(last);
+  }
+
+  Move bookMove() {
+    // The book is keyed by the current position, game trails it by history
+    for(Move m: history) game.doAction(m);
+    Move m = book->probe(game, rng);
+    for(int i=0;i<history.size();i++) game.undoAction();
+    return m;
   }
 
-  i5 getNextMove(int deep_size) {
-    int cnt = 0;
-    auto ret = root->getNextMove(game, deep_size, cnt);
+  Move tablebaseMove(double &score) {
+    /*
+      When the tables have the current position and every position a move
+      leads to, the best of them: the quickest mate, else a draw, else the
+      longest way to be mated. score is the position's, white's view.
+    */
+    for(Move m: history) game.doAction(m);
+    bool white = game.isWhiteTurn();
+    std::vector<Move> best;
+    if(tablebase->probe(game, score)) {
+      double best_score = -INF;
+      std::vector<Move> moves = game.getAllMoves();
+      for(Move m: moves) {
+        game.doAction(m);
+        double s;
+        bool known = game.isDraw() || game.isCheckMate();
+        if(known) s = game.getScore();
+        else known = tablebase->probe(game, s);
+        game.undoAction();
+        if(!known) {
+          best.clear();
+          break;
+        }
+        if(!white) s = -s;
+        if(cmp(s, best_score) == 1) {
+          best_score = s;
+          best.clear();
+        }
+        if(cmp(s, best_score) == 0) best.push_back(m);
+      }
+    }
+    for(int i=0;i<history.size();i++) game.undoAction();
+    if(best.empty()) return MOVE_NONE;
+    return best[std::uniform_int_distribution<int>(0, best.size() - 1)(rng)];
+  }
+
+  bool rootFinished(double &score) {
+    // Mate, stalemate or a draw by rule at the current position: nothing to search
+    for(Move m: history) game.doAction(m);
+    bool finished = game.isCheckMate() || game.isDraw() || game.getAllMoves().empty();
+    score = game.getScore();
+    for(int i=0;i<history.size();i++) game.undoAction();
+    return finished;
+  }
+
+  Move search(const SearchLimits &limits) {
+    settle();
+    double final_score;
+    if(rootFinished(final_score)) {
+      progress->best_move = MOVE_NONE;
+      last_search = {MOVE_NONE, final_score, 0, 0, 0.0};
+      last_iterations.clear();
+      last_pruning = PruningStats();
+      return MOVE_NONE;
+    }
+    if(book && !pondering) {
+      // A book move is played as it is, the tree and the TT are left alone
+      Move m = bookMove();
+      if(m != MOVE_NONE) {
+        if(verbose) std::cerr << "book move " << moveToString(m) << "\n";
+        progress->best_move = m;
+        last_search = {m, 0.0, 0, 0, 0.0};
+        last_iterations.clear();
+        last_pruning = PruningStats();
+        return m;
+      }
+    }
+    if(tablebase && !pondering) {
+      double score;
+      Move m = tablebaseMove(score);
+      if(m != MOVE_NONE) {
+        if(verbose) std::cerr << "tablebase move " << moveToString(m) << " (" << score << ")\n";
+        progress->best_move = m;
+        last_search = {m, score, 0, 0, 0.0};
+        last_iterations.clear();
+        last_pruning = PruningStats();
+        return m;
+      }
+    }
+
+    SearchContext ctx;
+    ctx.tt = &tt;
+    ctx.tablebase = tablebase.get();
+    ctx.rng = &rng;
+    ctx.progress = progress.get();
+    ctx.verbose = verbose && !pondering;
+    ctx.options = options;
+    ctx.start = std::chrono::steady_clock::now();
+    setTimeControl(limits, ctx);
+    ctx.node_limit = limits.nodes;
+    if(!pondered) tt.newSearch();
+    pondered = false;
+    if(tree.size() > tree.capacity() / 2) rebase(); // Room for this search to grow the tree
+
+    /*
+      Lazy SMP: helpers search the same root on their own Game and tree, with
+      their own shuffle, half of them a depth ahead. They only share the TT,
+      which is what speeds up the main thread; its move is the one played.
+    */
+    std::vector<std::thread> pool;
+    helpers.resize(threads - 1);
+    for(int i=1;i<threads;i++) {
+      if(!helpers[i - 1]) helpers[i - 1] = std::make_unique<Helper>(treeShare());
+      Helper &h = *helpers[i - 1];
+      h.game = game;
+      for(Move m: history) h.game.doAction(m);
+      h.tree.reset();
+      h.rng.seed(rng());
+      h.progress.reset();
+
+      h.ctx = ctx;
+      h.ctx.rng = &h.rng;
+      h.ctx.progress = &h.progress;
+      h.ctx.verbose = false;
+      h.ctx.helper = true;
+      h.ctx.node_limit = 0; // Helpers run until the main thread is done
+      h.ctx.first_depth = 1 + (i & 1);
+      pool.emplace_back([&h, &limits]() { h.tree.getNextMove(h.game, limits.depth, h.ctx); });
+    }
+
+    Move ret = tree.getNextMove(game, limits.depth, ctx);
+
+    uint64_t nodes = ctx.nodes;
+    TTStats tt_stats = ctx.tt_stats;
+    PruningStats pruning = ctx.pruning;
+    for(auto &h: helpers) h->progress.stop = true;
+    for(auto &t: pool) t.join();
+    for(auto &h: helpers) {
+      nodes += h->ctx.nodes;
+      tt_stats += h->ctx.tt_stats;
+      pruning += h->ctx.pruning;
+    }
+
+    if(ctx.verbose) {
+      std::cerr << nodes << " nodes generated (" << threads << " threads)\n";
+      std::cerr << ctx.researches << " aspiration re-searches\n";
+      std::cerr << "null move: " << pruning.null_cutoffs << " cutoffs in " << pruning.null_tries << " tries, ";
+      std::cerr << "reductions: " << pruning.reductions << " (" << pruning.reduction_researches << " re-searched), ";
+      std::cerr << "futile moves: " << pruning.futile << ", tablebase hits: " << pruning.tb_hits << "\n";
+      tt.report(tt_stats);
+    }
+
+    int depth = (ctx.iterations.empty() ? 0 : ctx.iterations.back().depth);
+    last_search = {ret, ctx.score, depth, nodes, ctx.elapsed()};
+    last_iterations = ctx.iterations;
+    last_pruning = pruning;
     return ret;
   }
 
-  void moveDone(i5 move) {
-    root->moveDone(game, move);
+  void setTimeControl(const SearchLimits &limits, SearchContext &ctx) {
+    /*
+      A fixed move time is a hard deadline. With a clock the move gets its
+      share of the remaining time plus most of the increment, and may run to
+      three times that (never past half the clock) to finish an iteration.
+      No iteration starts after half the target.
+    */
+    const double overhead = 0.05;
+    double target = 0.0, limit = 0.0;
+
+    if(limits.move_time > 0) {
+      target = limit = std::max(limits.move_time - overhead, 0.01);
+    } else if(limits.remaining > 0) {
+      int moves_to_go = (limits.moves_to_go > 0 ? limits.moves_to_go : 30);
+      target = limits.remaining / moves_to_go + limits.increment * 0.75;
+      limit = std::max(std::min(target * 3, limits.remaining * 0.5) - overhead, 0.01);
+      target = std::min(target, limit);
+    } else {
+      return; // Depth only
+    }
+
+    ctx.has_deadline = true;
+    ctx.progress->time_limit = limit;
+    ctx.soft_time = target * 0.5;
+    ctx.deadline = ctx.start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(limit));
+  }
+
+public:
+
+  Engine(int hash_mb = 64, int tree_mb = 256) : tree(tree_mb), tree_mb(tree_mb), tt(hash_mb) {
+    progress = std::make_unique<SearchProgress>();
+    pondering = false;
+    pondered = false;
+    threads = 1;
+    rng.seed(std::chrono::steady_clock::now().time_since_epoch().count());
+    verbose = true;
+    last_search = {MOVE_NONE, 0.0, 0, 0, 0.0};
+  }
+
+  // Only an idle engine may be moved, one not searching nor rerooting
+  Engine(Engine &&) = default;
+  Engine &operator=(Engine &&) = default;
+
+  ~Engine() {
+    if(pending.valid()) {
+      stop();
+      pending.wait();
+    }
+    settle();
+  }
+
+  void setHashSize(int hash_mb) {
+    tt.resize(hash_mb);
+  }
+
+  void setTreeSize(int tree_mb) {
+    // Memory for the search trees of all threads, the current tree is dropped
+    assert(!isSearching());
+    settle();
+    this->tree_mb = tree_mb;
+    rebase();
+    tree.setBudget(treeShare());
+    helpers.clear();
+  }
+
+  void setThreads(int threads) {
+    // The calling thread plus threads - 1 helpers per search
+    assert(!isSearching());
+    if(this->threads == std::max(1, threads)) return;
+    this->threads = std::max(1, threads);
+    setTreeSize(tree_mb);
+  }
+
+  void setSeed(uint32_t seed) {
+    // Move order shuffling and the pick among equal moves both use this rng
+    rng.seed(seed);
+  }
+
+  void setSearchOptions(const SearchOptions &options) {
+    assert(!isSearching());
+    this->options = options;
+  }
+
+  const SearchOptions &getSearchOptions() const {
+    return options;
+  }
+
+  void setNetwork(std::shared_ptr<const Nnue::Network> network) {
+    // Evaluation by a loaded network, nullptr goes back to the piece-square tables
+    assert(!isSearching());
+    settle();
+    this->network = network;
+    rebase(); // Scores in the tree and the TT came from the other evaluation
+    game.setNetwork(network);
+    tt.clear();
+  }
+
+  void setBook(std::shared_ptr<const OpeningBook> book) {
+    // Searches first look for the position in the book, nullptr turns it off
+    assert(!isSearching());
+    this->book = book;
+  }
+
+  void setTablebase(std::shared_ptr<const EndgameTables> tablebase) {
+    // Endgame tables for the root and the search, nullptr turns them off
+    assert(!isSearching());
+    settle();
+    this->tablebase = tablebase;
+    rebase(); // Tree and TT scores were searched without them
+    tt.clear();
+  }
+
+  void setVerbose(bool verbose) {
+    this->verbose = verbose;
+  }
+
+  void setPosition(const std::string &fen, bool clear_hash = true) {
+    assert(!isSearching());
+    settle();
+    game = Game(fen);
+    game.setNetwork(network);
+    history.clear();
+    tree.reset();
+    if(clear_hash) tt.clear();
+  }
+
+  double getStaticScore() {
+    // The current position's evaluation, white's view, without searching
+    assert(!isSearching());
+    settle();
+    for(Move m: history) game.doAction(m);
+    double score = game.getStaticScore();
+    for(int i=0;i<history.size();i++) game.undoAction();
+    return score;
+  }
+
+  Move getNextMove(const SearchLimits &limits) {
+    assert(!isSearching());
+    progress->reset();
+    return search(limits);
+  }
+
+  Move getNextMove(int deep_size) {
+    SearchLimits limits;
+    limits.depth = deep_size;
+    return getNextMove(limits);
+  }
+
+  /*
+    Background search on the engine's own Game, so the caller's Game is never
+    shared with it. Until searchResult() is collected the engine must not get
+    any other call but stop() and getProgress().
+  */
+  void startSearch(const SearchLimits &limits) {
+    assert(!isSearching());
+    progress->reset();
+    pending = std::async(std::launch::async, [this, limits]() { return search(limits); });
+  }
+
+  bool isSearching() const {
+    return pending.valid();
+  }
+
+  bool isPondering() const {
+    return pending.valid() && pondering;
+  }
+
+  bool isSearchReady() const {
+    return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  Move searchResult() {
+    // Waits for the search if it is still running
+    return pending.get();
+  }
+
+  void stop() {
+    // The search returns its best completed depth (depth 1 always completes)
+    progress->stop = true;
+  }
+
+  const SearchProgress &getProgress() const {
+    return *progress;
+  }
+
+  double searchScore(int deep, double alpha, double beta) {
+    /*
+      Score of the current position as a child of the search root, used by
+      the distributed root split. Outside (alpha, beta) it is only a bound,
+      like any cutoff in explore.
+    */
+    assert(!isSearching());
+    settle();
+    progress->reset();
+    SearchContext ctx;
+    ctx.tt = &tt;
+    ctx.rng = &rng;
+    ctx.progress = progress.get();
+    ctx.options = options;
+    ctx.start = std::chrono::steady_clock::now();
+    tt.newSearch();
+
+    double sc = tree.searchScore(game, deep, alpha, beta, ctx);
+
+    last_search = {MOVE_NONE, sc, deep, ctx.nodes, ctx.elapsed()};
+    return sc;
+  }
+
+  const SearchResult &getLastSearch() const {
+    return last_search;
+  }
+
+  const std::vector<SearchResult> &getLastIterations() const {
+    return last_iterations;
+  }
+
+  const PruningStats &getLastPruning() const {
+    return last_pruning;
+  }
+
+  uint64_t getTreeNodes() const {
+    // Nodes in the main thread's tree
+    settle();
+    return tree.size();
+  }
+
+  /*
+    Searches the opponent's position while they think, within limits. Every
+    reply gets explored in the persistent search tree and the TT, so the
+    search after moveDone finds its first depths already done. moveDone
+    stops the ponder.
+  */
+  void startPonder(const SearchLimits &limits) {
+    assert(!isSearching());
+    pondering = true;
+    startSearch(limits);
+  }
+
+  void moveDone(Move move) {
+    if(isPondering()) {
+      stop();
+      searchResult();
+      pondering = false;
+      pondered = true;
+      if(verbose) {
+        std::cerr << "ponder: depth " << last_search.depth << ", " << last_search.nodes << " nodes in ";
+        std::cerr << last_search.seconds << "s\n";
+      }
+    }
+    assert(!isSearching());
+    settle();
+    bool kept = tree.moveDone(game, move, rng);
+    history.push_back(move);
+    if(!kept) {
+      rebase(); // No room left to expand the position the move was made in
+      return;
+    }
+
+    /*
+      Only the played move's subtree stays useful. Copying it out happens in
+      the background, so the memory of the rest is given back without
+      holding up the caller; the next search waits for it if needed.
+    */
+    reroot_job = std::async(std::launch::async, [this]() {
+      tree.reroot(game);
+      history.clear();
+    });
+
   }
 
   void performance() {
+    // Global counters only: no need to wait for the reroot
     game.performance();
   }
 };
@@ -0,0 +1,140 @@
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+
+#include <array>
+
+#include <Position.hpp>
+
+/*
+  Piece-square tables, in centipawns on top of the material, tapered
+  between a middlegame and an endgame table by the pieces left on the
+  board. Tables are drawn from white's side, a8 first, so a white piece
+  reads its own square (a8 = 0, like Position) and a black one the square
+  mirrored across the middle rank.
+
+  The middlegame tables are the "simplified evaluation function" ones. In
+  the endgame the king heads for the centre and pawns count by how far
+  they have advanced; the other pieces keep their middlegame tables.
+
+  Everything is summed in whole centipawns: a position scores the same
+  whichever move order reached it, which the search relies on when it
+  matches root scores against the TT.
+*/
+namespace Evaluation {
+  constexpr int VALUE[6] = {100, 300, 300, 500, 900, 0};
+
+  // Knights and bishops count 1, rooks 2, queens 4: 24 with every piece on the board
+  const int MAX_PHASE = 24;
+
+  constexpr int MIDDLEGAME[6][64] = {
+    { // Pawn
+        0,   0,   0,   0,   0,   0,   0,   0,
+       50,  50,  50,  50,  50,  50,  50,  50,
+       10,  10,  20,  30,  30,  20,  10,  10,
+        5,   5,  10,  25,  25,  10,   5,   5,
+        0,   0,   0,  20,  20,   0,   0,   0,
+        5,  -5, -10,   0,   0, -10,  -5,   5,
+        5,  10,  10, -20, -20,  10,  10,   5,
+        0,   0,   0,   0,   0,   0,   0,   0
+    },
+    { // Knight
+      -50, -40, -30, -30, -30, -30, -40, -50,
+      -40, -20,   0,   0,   0,   0, -20, -40,
+      -30,   0,  10,  15,  15,  10,   0, -30,
+      -30,   5,  15,  20,  20,  15,   5, -30,
+      -30,   0,  15,  20,  20,  15,   0, -30,
+      -30,   5,  10,  15,  15,  10,   5, -30,
+      -40, -20,   0,   5,   5,   0, -20, -40,
+      -50, -40, -30, -30, -30, -30, -40, -50
+    },
+    { // Bishop
+      -20, -10, -10, -10, -10, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,  10,  10,   5,   0, -10,
+      -10,   5,   5,  10,  10,   5,   5, -10,
+      -10,   0,  10,  10,  10,  10,   0, -10,
+      -10,  10,  10,  10,  10,  10,  10, -10,
+      -10,   5,   0,   0,   0,   0,   5, -10,
+      -20, -10, -10, -10, -10, -10, -10, -20
+    },
+    { // Rook
+        0,   0,   0,   0,   0,   0,   0,   0,
+        5,  10,  10,  10,  10,  10,  10,   5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+       -5,   0,   0,   0,   0,   0,   0,  -5,
+        0,   0,   0,   5,   5,   0,   0,   0
+    },
+    { // Queen
+      -20, -10, -10,  -5,  -5, -10, -10, -20,
+      -10,   0,   0,   0,   0,   0,   0, -10,
+      -10,   0,   5,   5,   5,   5,   0, -10,
+       -5,   0,   5,   5,   5,   5,   0,  -5,
+        0,   0,   5,   5,   5,   5,   0,  -5,
+      -10,   5,   5,   5,   5,   5,   0, -10,
+      -10,   0,   5,   0,   0,   0,   0, -10,
+      -20, -10, -10,  -5,  -5, -10, -10, -20
+    },
+    { // King
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -20, -30, -30, -40, -40, -30, -30, -20,
+      -10, -20, -20, -20, -20, -20, -20, -10,
+       20,  20,   0,   0,   0,   0,  20,  20,
+       20,  30,  10,   0,   0,  10,  30,  20
+    }
+  };
+
+  constexpr int ENDGAME_PAWN[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     80,  80,  80,  80,  80,  80,  80,  80,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     15,  15,  15,  15,  15,  15,  15,  15,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0
+  };
+
+  constexpr int ENDGAME_KING[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50
+  };
+
+  constexpr std::array<std::array<int, 64>, 16> buildTable(bool endgame) {
+    // Indexed by Piece and signed for the side: white adds, black subtracts
+    std::array<std::array<int, 64>, 16> t{};
+    for(int color=WHITE;color<=BLACK;color++) {
+      for(int type=PAWN;type<=KING;type++) {
+        for(int sq=0;sq<64;sq++) {
+          int own = (color == WHITE ? sq : sq ^ 56);
+          int value = MIDDLEGAME[type][own];
+          if(endgame && type == PAWN) value = ENDGAME_PAWN[own];
+          if(endgame && type == KING) value = ENDGAME_KING[own];
+          t[(color << 3) | (type + 1)][sq] = (color == WHITE ? value : -value);
+        }
+      }
+    }
+    return t;
+  }
+
+  inline constexpr std::array<std::array<int, 64>, 16> MG = buildTable(false);
+  inline constexpr std::array<std::array<int, 64>, 16> EG = buildTable(true);
+
+  inline int taper(int mg, int eg, int phase) {
+    if(phase > MAX_PHASE) phase = MAX_PHASE;
+    return (mg * phase + eg * (MAX_PHASE - phase)) / MAX_PHASE;
+  }
+}
+
+#endif
@@ -2,22 +2,49 @@
 #define GAME_HPP
 
 #include <iostream>
-#include <map>
+#include <array>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <assert.h>
 
+#include <Position.hpp>
+#include <Profiler.hpp>
+#include <Move.hpp>
+#include <Nnue.hpp>
+#include <Zobrist.hpp>
+
 typedef std::pair<int, int> pii;
 
+struct SquareChanges {
+  // Squares written by one move (castling touches 4) and the piece on each
+  int count = 0;
+  uint8_t square[4];
+  Piece piece[4];
+
+  void add(int sq, Piece p) {
+    assert(count < 4);
+    square[count] = sq;
+    piece[count] = p;
+    count++;
+  }
+};
+
 struct GameState {
   pii enPassant;
   int castlingPreserved;
   std::string gameStatus;
   double gameScore;
+  bool scored; // gameScore is up to date; with a network it is only worked out when asked for
+  int material; // Centipawns, white's view
+  int psq_mg, psq_eg; // Piece-square terms, see Evaluation.hpp
   int moves_white;
   int moves_black;
   bool repetition;
+  uint64_t key;
+  int reversible_moves;
 
-  std::vector<int> pieces_counter;
+  std::array<int, 12> pieces_counter;
 
   bool isCastlingPreserved(int id) const {
     // 0: o-o-o white, 1: o-o white, 2: o-o-o black, 3: o-o black
@@ -34,47 +61,68 @@ struct GameState {
 class Game {
 private:
   std::vector<GameState> gameState;
-  std::vector<std::vector<std::string>> board;
-  std::vector<std::pair<pii, pii>> nextMoves;
-  std::map<std::string, int> hashedBoardCounter;
-  std::vector<std::vector<std::pair<pii, std::string>>> moves;
-
-  // Performance
-  std::map<std::string, double> elapsed_sec;
-  std::map<std::string, int> called_counter;
+  Position position;
+  std::deque<std::vector<Move>> nextMoves; // Per ply, generated on demand
+  std::vector<bool> nextMovesReady;
+  std::vector<SquareChanges> moves; // Rollback record per ply
+  int first_ply; // 1 when the game starts with black to move
+  std::shared_ptr<const Nnue::Network> network; // Evaluation, piece-square tables without one
+  std::vector<Nnue::Accumulator> accumulators; // Per ply like gameState, only with a network
 
   GameState getState() const;
   void addState(GameState gs);
+  void setupState(GameState gs);
 
   void buildBoard();
-  std::string getBoardHash();
-  int storeHashedBoard();
-  std::string getPositionInfo(int x, int y) const;
-  bool isValidMove(pii curr_pos, pii new_pos);
-  bool isOnCheck();
-  void genNextMoves(const GameState gs);
+  uint64_t computeKey(const GameState &gs) const;
+  uint64_t castlingKey(const GameState &gs) const;
+  uint64_t enPassantKey(const GameState &gs) const;
+  bool isRepetition(const GameState &gs) const;
+  Piece getPositionInfo(int x, int y) const;
+  Bitboard pinnedPieces(int us) const;
+  void genNextMoves(const GameState &gs);
+  std::vector<Move> &getNextMoves();
+  void resolveStatus();
   pii getKingPos(bool white);
   bool drawConditions(const GameState &gs) const;
-  void executeMove(std::vector<std::pair<pii, std::string>> &move, GameState &gs);
-  double evaluatePiece(std::string piece);
+  void executeMove(const SquareChanges &move, GameState &gs);
+  double evaluatePiece(Piece piece) const;
+  void addPiece(GameState &gs, Piece piece, int sq, int sign) const;
+  double evaluateState(const GameState &gs, bool white_turn) const;
+  void scoreState();
 
 public:
   Game();
+  Game(const std::string &fen);
+  static bool isValidFen(const std::string &fen, std::string &error); // The constructor asserts it
 
   std::vector<std::vector<std::string>> getBoard(int move_id=-1);
   void undoAction();
-  void doAction(pii current_pos, pii new_pos, int choose=-1);
+  void doAction(Move move);
+  void doNullMove(); // Passes the turn, undone with undoAction
+  void setNetwork(std::shared_ptr<const Nnue::Network> network); // nullptr: piece-square tables
   std::vector<std::pair<pii, int>> getSpecialCells(pii cell);
-  bool isDraw() const;
-  bool isCheckMate() const;
+  bool isDraw();
+  bool isCheckMate();
+  bool isOnCheck();
   bool isWhiteTurn() const;
+  bool hasPieces(bool white) const; // Anything besides pawns and the king
   bool hasMoveFor(pii pos);
   bool isPawnPromotion(pii curr_pos, pii new_pos);
   bool isAvailable(pii curr_pos, pii new_pos);
+  bool isAvailable(Move move);
+  Move getMove(pii curr_pos, pii new_pos, int choose=-1);
+  Move getMove(const std::string &notation);
   int getTotalMoves() const;
-  std::vector<std::pair<pii, pii>> getAllMoves();
-  double getScore() const;
+  const std::vector<Move> &getAllMoves();
+  double getScore();
+  double getStaticScore();
+  uint64_t getKey() const;
   double getCellScore(int x, int y) const;
+  Piece getPiece(int sq) const;
+  const Position &getPosition() const;
+  int getPieceCount() const; // Kings included
+  bool hasSpecialRights() const; // A castling right left or an en passant capture on
 
   // Performance
   void performance();
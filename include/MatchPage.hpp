@@ -54,7 +54,14 @@ private:
 
   int MATCH_MODE = 3;
   Engine engine;
-  int DEEP_SIZE = 4;
+  // Bot clock in seconds: what is left and what each move gives back
+  double bot_clock = 5 * 60.0;
+  double CLOCK_INCREMENT = 3.0;
+
+  // The bot searches in the background: Space forces its move, Escape cancels it
+  bool bot_paused = false;
+  bool PONDER = true; // Keep searching on the player's time
+  std::chrono::steady_clock::time_point search_start;
 
   void createButtons() {
     // Board cells
@@ -139,6 +146,32 @@ private:
     }
   }
 
+  void drawSearchProgress(sf::RenderWindow &window) {
+    if(!engine.isSearching() || engine.isPondering()) return;
+    const SearchProgress &progress = engine.getProgress();
+
+    // Best move of the last completed depth
+    Move best = progress.best_move;
+    if(best != MOVE_NONE) {
+      sf::Color c(60, 120, 220);
+      for(int sq: {moveFrom(best), moveTo(best)}) {
+        const Button &b = buttons[squareX(sq) * 8 + squareY(sq)];
+        window.draw(createSquare(b.x0, b.y0, c));
+      }
+    }
+
+    // Time used out of the hard limit, under the board
+    double limit = progress.time_limit;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+    float fill = (limit > 0 ? std::min(1.0, elapsed / limit) : 1.0);
+    float y = PADDING + 8.0 * SQUARE_SIZE + 10.f;
+
+    sf::RectangleShape bar({8.0f * SQUARE_SIZE * fill, 10.f});
+    bar.setFillColor(sf::Color(60, 120, 220));
+    bar.setPosition({PADDING, y});
+    window.draw(bar);
+  }
+
   void drawActionButtons(sf::RenderWindow &window) {
     sf::Texture texture;
     int offset_id = 8*8 + 4;
@@ -209,9 +242,9 @@ private:
     }
   }
 
-  void doGameMove(pii curr_pos, pii new_pos, int choose=-1) {
-    game.doAction(curr_pos, new_pos, choose);
-    engine.moveDone({{curr_pos, new_pos}, choose});
+  void doGameMove(Move m) {
+    game.doAction(m);
+    engine.moveDone(m);
     move_counter = game.getTotalMoves();
     engine.performance();
     std::cerr << "Score: " << game.getScore() << "\n";
@@ -220,7 +253,7 @@ private:
 
   void handlePromotion(int button_id) {
     assert(move.size() == 2);
-    doGameMove(move[0], move[1], button_id - 64);
+    doGameMove(game.getMove(move[0], move[1], button_id - 64));
     showPromotionSquare = false;
     move.clear();
   }
@@ -246,7 +279,7 @@ private:
         if(game.isPawnPromotion(move[0], move[1])) {
           showPromotionSquare = true; // Waiting for promoted selection
         } else {
-          doGameMove(move[0], move[1]); // Executing move
+          doGameMove(game.getMove(move[0], move[1])); // Executing move
           move.clear();
         }
       } else {
@@ -255,19 +288,38 @@ private:
     }
   }
 
+  SearchLimits botLimits() const {
+    SearchLimits limits;
+    limits.remaining = bot_clock;
+    limits.increment = CLOCK_INCREMENT;
+    return limits;
+  }
+
   void botAction() {
     if(isPlayerTurn()) return;
     if(game.isCheckMate() || game.isDraw()) return;
 
-    std::clock_t t = std::clock();
-    i5 move = engine.getNextMove(DEEP_SIZE);
-    doGameMove(move.first.first, move.first.second, move.second);
-    t = (std::clock() - t);
-    int seconds = t / CLOCKS_PER_SEC;
-    int minutes = seconds / 60;
-    seconds = seconds % 60;
+    if(!engine.isSearching()) {
+      if(bot_paused) return;
+      search_start = std::chrono::steady_clock::now();
+      engine.startSearch(botLimits());
+      return;
+    }
+
+    if(!engine.isSearchReady()) return; // Still thinking, keep drawing
+
+    Move move = engine.searchResult();
+    if(bot_paused) return; // Cancelled, the move is dropped
+    doGameMove(move);
+
+    const SearchResult &result = engine.getLastSearch();
+    bot_clock = std::max(0.0, bot_clock - result.seconds) + CLOCK_INCREMENT;
+
+    std::cerr << "Depth reached: " << result.depth << "\n";
+    std::cerr << "Time elapsed: " << result.seconds << "s, clock " << (int)bot_clock / 60 << "m" << (int)bot_clock % 60 << "s\n";
 
-    std::cerr << "Time elapsed: " << minutes << "m" << seconds << "s\n";
+    // Think on the player's time, for as long as the bot would on its own move
+    if(PONDER && isPlayerTurn() && !game.isCheckMate() && !game.isDraw()) engine.startPonder(botLimits());
   }
 
 public:
@@ -278,6 +330,14 @@ public:
     HEIGHT = height;
     showPromotionSquare = false;
     move_counter = 0;
+    engine.setThreads(std::thread::hardware_concurrency());
+
+    // The book is optional, the bot searches from the first move without it
+    auto book = std::make_shared<OpeningBook>();
+    std::string error;
+    if(book->open("assets/book.bin", error)) engine.setBook(book);
+    auto tablebase = std::make_shared<EndgameTables>();
+    if(tablebase->open("assets/tb", error) && tablebase->size() > 0) engine.setTablebase(tablebase);
     createButtons();
   }
 
@@ -286,6 +346,7 @@ public:
     drawBoard(window);
     drawPieces(window);
     drawActionButtons(window);
+    drawSearchProgress(window);
     if(showPromotionSquare) drawPromotionOption(window);
 
     botAction();
@@ -331,6 +392,19 @@ public:
     return true;
   }
 
+  void handleKey(const sf::Event::KeyPressed *event) {
+    if(event->code == sf::Keyboard::Key::Space) {
+      // Resume a cancelled bot, or make it play its best move so far
+      if(bot_paused) bot_paused = false;
+      else if(engine.isSearching() && !engine.isPondering()) engine.stop();
+    } else if(event->code == sf::Keyboard::Key::Escape) {
+      if(engine.isSearching() && !engine.isPondering()) {
+        bot_paused = true;
+        engine.stop();
+      }
+    }
+  }
+
   void handleClick(const sf::Event::MouseButtonPressed *event) {
     int mouse_x = event->position.x;
     int mouse_y = event->position.y;
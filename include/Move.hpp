@@ -0,0 +1,48 @@
+#ifndef MOVE_HPP
+#define MOVE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <Position.hpp>
+
+/*
+  A move packed in 16 bits:
+    bits 0-5   from square
+    bits 6-11  to square
+    bits 12-13 flag (normal, promotion, en passant, castling)
+    bits 14-15 promotion choice, as offered by the UI: 0 q, 1 r, 2 n, 3 b
+*/
+typedef uint16_t Move;
+
+const Move MOVE_NONE = 0;
+
+enum MoveFlag { MOVE_NORMAL = 0, MOVE_PROMOTION = 1, MOVE_EN_PASSANT = 2, MOVE_CASTLING = 3 };
+
+inline Move makeMove(int from, int to, int flag = MOVE_NORMAL, int choose = 0) {
+  return from | (to << 6) | (flag << 12) | (choose << 14);
+}
+
+inline int moveFrom(Move m) { return m & 63; }
+inline int moveTo(Move m) { return (m >> 6) & 63; }
+inline int moveFlag(Move m) { return (m >> 12) & 3; }
+inline int moveChoose(Move m) { return moveFlag(m) == MOVE_PROMOTION ? (m >> 14) : -1; }
+
+inline int promotionType(Move m) {
+  const int promotion[4] = {QUEEN, ROOK, KNIGHT, BISHOP};
+  return promotion[m >> 14];
+}
+
+inline std::string moveToString(Move m) {
+  // Coordinate notation, e.g. e2e4 or e7e8q
+  if(m == MOVE_NONE) return "0000";
+  std::string s;
+  s += char('a' + squareX(moveFrom(m)));
+  s += char('8' - squareY(moveFrom(m)));
+  s += char('a' + squareX(moveTo(m)));
+  s += char('8' - squareY(moveTo(m)));
+  if(moveFlag(m) == MOVE_PROMOTION) s += "qrnb"[m >> 14];
+  return s;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef MOVE_ORDERING_HPP
+#define MOVE_ORDERING_HPP
+
+#include <cstdint>
+
+#include <Game.hpp>
+#include <Move.hpp>
+
+/*
+  Order in which explore tries the moves of a node, best first:
+    the TT move,
+    captures and promotions by MVV-LVA (most valuable victim, then least
+    valuable attacker),
+    the two killer moves of the ply (quiet moves that cut off a sibling),
+    quiet moves by their history score (how often and how deep they cut off).
+  Each search thread keeps its own killers and history.
+*/
+class MoveOrdering {
+public:
+  static const int MAX_PLY = 128;
+
+  static const int HASH_KEY = 1 << 30;
+  static const int CAPTURE_KEY = 1 << 29;
+  static const int KILLER_KEY = 1 << 28;
+  static const int HISTORY_MAX = 1 << 20; // History keys stay below the killers
+
+private:
+  Move killers[MAX_PLY][2];
+  int history[2][64][64]; // Side to move, from, to
+
+public:
+  MoveOrdering();
+
+  void clear();
+  bool isQuiet(const Game &game, Move move) const;
+  int gain(const Game &game, Move move) const; // Material won by a capture or promotion, in pawns
+  int key(const Game &game, Move move, Move hash_move, int ply) const;
+  void cutoff(const Game &game, Move move, int deep, int ply); // Called for quiet moves only
+};
+
+#endif
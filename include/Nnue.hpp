@@ -0,0 +1,73 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Position.hpp>
+
+/*
+  Efficiently updatable network, an optional replacement for the
+  piece-square evaluation. Integer only, on the CPU.
+
+    768 inputs per side -> 2 x HIDDEN -> L1 -> 1
+
+  Each side sees the board from its own end: feature (own/their pieces * 6
+  + type) * 64 + square, with squares as Position numbers them (a8 = 0)
+  and flipped vertically for black. The two accumulators (bias plus the
+  rows of the pieces on the board) are updated per changed square as moves
+  are made, so a move costs the same whatever the number of pieces.
+
+  To evaluate, the side to move's accumulator then the other's are clipped
+  to [0, 127] and go through an int8 layer (shifted right by WEIGHT_SHIFT,
+  clipped again) and an int8 output. The output over OUTPUT_SCALE is the
+  score in centipawns for the side to move.
+
+  The file, little endian: "NNUE", uint32 version, hidden size and L1
+  size, then feature weights int16[768][HIDDEN], feature bias
+  int16[HIDDEN], L1 weights int8[L1][2 * HIDDEN], L1 bias int32[L1],
+  output weights int8[L1] and output bias int32.
+*/
+namespace Nnue {
+  const int INPUTS = 768;
+  const int HIDDEN = 256;
+  const int L1 = 32;
+  const int WEIGHT_SHIFT = 6;
+  const int OUTPUT_SCALE = 16;
+  const uint32_t VERSION = 1;
+
+  struct Accumulator {
+    std::array<std::array<int16_t, HIDDEN>, 2> values; // Indexed by the side looking
+  };
+
+  inline int feature(int side, Piece p, int sq) {
+    int relative = (pieceColor(p) == side ? 0 : 1);
+    if(side == BLACK) sq ^= 56;
+    return (relative * 6 + pieceType(p)) * 64 + sq;
+  }
+
+  class Network {
+  private:
+    std::vector<int16_t> ft_weights;
+    std::vector<int16_t> ft_bias;
+    std::vector<int8_t> l1_weights;
+    std::vector<int32_t> l1_bias;
+    std::vector<int8_t> out_weights;
+    int32_t out_bias;
+
+    void addFeature(Accumulator &acc, Piece p, int sq, int sign) const;
+
+  public:
+    bool load(const std::string &path, std::string &error);
+
+    void refresh(const Position &position, Accumulator &acc) const;
+    void update(Accumulator &acc, int sq, Piece removed, Piece added) const;
+    int evaluate(const Accumulator &acc, int us) const;
+
+    static const char *kernel(); // The SIMD flavour compiled in
+  };
+}
+
+#endif
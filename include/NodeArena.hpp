@@ -0,0 +1,69 @@
+#ifndef NODE_ARENA_HPP
+#define NODE_ARENA_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <Move.hpp>
+
+typedef uint32_t NodeIndex;
+
+const NodeIndex NO_NODE = UINT32_MAX;
+
+/*
+  Storage of the search tree: one row per node in a structure of arrays,
+  addressed by index, with row 0 as the root. The children of a node are a
+  contiguous block of rows kept in the order they are searched, so sorting
+  the moves of a node moves its rows (and their child links) around.
+
+  The arena holds at most a budget of rows. Once it is full expand() fails
+  and the search carries on below that node without storing it.
+*/
+class NodeArena {
+public:
+  struct Row {
+    Move move;
+    double order; // Score of the node as its parent saw it, the sort key among siblings
+    NodeIndex children;
+    uint8_t count;
+  };
+
+private:
+  std::vector<Move> moves;
+  std::vector<double> orders;
+  std::vector<NodeIndex> children; // First child, NO_NODE until expanded
+  std::vector<uint8_t> counts;
+  uint64_t max_nodes;
+  uint64_t peak;
+
+  void grow(uint64_t size);
+
+public:
+  NodeArena(int size_mb = 64);
+
+  void setBudget(int size_mb); // Drops the tree
+  void reset(); // Back to a lone root
+  bool expand(NodeIndex node, const std::vector<Move> &child_moves);
+
+  Move move(NodeIndex i) const { return moves[i]; }
+  double order(NodeIndex i) const { return orders[i]; }
+  void setOrder(NodeIndex i, double value) { orders[i] = value; }
+  NodeIndex firstChild(NodeIndex i) const { return children[i]; }
+  int childCount(NodeIndex i) const { return counts[i]; }
+
+  Row row(NodeIndex i) const { return {moves[i], orders[i], children[i], counts[i]}; }
+  void setRow(NodeIndex i, const Row &r) {
+    moves[i] = r.move;
+    orders[i] = r.order;
+    children[i] = r.children;
+    counts[i] = r.count;
+  }
+
+  uint64_t size() const { return moves.size(); }
+  uint64_t capacity() const { return max_nodes; }
+  uint64_t peakSize() const { return peak; }
+  bool isFull() const { return moves.size() >= max_nodes; }
+  static uint64_t bytesPerNode();
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef OPENING_BOOK_HPP
+#define OPENING_BOOK_HPP
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Game.hpp>
+
+/*
+  Polyglot opening book, memory mapped and read in place. The file is a
+  sorted array of 16-byte big-endian entries: position key, move, weight
+  and a learn field (unused). Keys are Game::getKey(), the Polyglot key
+  (Zobrist.hpp), so books from tools/book.cpp and published Polyglot books
+  both work.
+
+  Moves are packed as to (bits 0-5), from (6-11) and promotion piece
+  (12-14: 1 knight .. 4 queen), squares counted from a1; castling is
+  written as the king taking its own rook.
+*/
+class OpeningBook {
+public:
+  struct Entry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+  };
+
+  static const int ENTRY_SIZE = 16;
+
+private:
+  const uint8_t *data;
+  uint64_t entries;
+  uint64_t mapped; // Bytes
+
+  Entry entry(uint64_t i) const;
+
+public:
+  OpeningBook();
+  ~OpeningBook();
+  OpeningBook(const OpeningBook &) = delete;
+  OpeningBook &operator=(const OpeningBook &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  void close();
+  bool isOpen() const { return data != nullptr; }
+  uint64_t size() const { return entries; }
+
+  std::vector<Entry> lookup(uint64_t key) const; // Binary search, heaviest first as the file keeps them
+  Move probe(Game &game, std::mt19937 &rng) const; // Weighted pick, MOVE_NONE out of book
+
+  static uint16_t encodeMove(Move m);
+  static Move decodeMove(Game &game, uint16_t move); // MOVE_NONE if not legal in game
+  static void writeEntry(uint8_t *out, const Entry &e);
+};
+
+#endif
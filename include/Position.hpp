@@ -0,0 +1,169 @@
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+typedef uint64_t Bitboard;
+typedef uint8_t Piece;
+
+/*
+  Squares follow the board coordinates used by Game: x is the file (0 = a)
+  and y is the row as drawn on screen (0 = black back rank, 7 = white back
+  rank). The square index is y * 8 + x, so a8 = 0 and h1 = 63.
+*/
+
+enum Color { WHITE = 0, BLACK = 1 };
+enum PieceType { PAWN = 0, KNIGHT = 1, BISHOP = 2, ROOK = 3, QUEEN = 4, KING = 5 };
+
+const Piece NO_PIECE = 0;
+
+inline Piece makePiece(int color, int type) { return (color << 3) | (type + 1); }
+inline int pieceColor(Piece p) { return p >> 3; }
+inline int pieceType(Piece p) { return (p & 7) - 1; }
+
+inline int makeSquare(int x, int y) { return y * 8 + x; }
+inline int squareX(int sq) { return sq & 7; }
+inline int squareY(int sq) { return sq >> 3; }
+inline Bitboard squareBB(int sq) { return 1ULL << sq; }
+
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+inline int msb(Bitboard b) { return 63 - __builtin_clzll(b); }
+inline int popCount(Bitboard b) { return __builtin_popcountll(b); }
+inline int popLsb(Bitboard &b) {
+  int sq = lsb(b);
+  b &= b - 1;
+  return sq;
+}
+
+namespace Attacks {
+  // 0..3 grow the square index (E, S, SE, SW), 4..7 shrink it (W, N, NW, NE)
+  constexpr int DX[8] = {1, 0, 1, -1, -1, 0, -1, 1};
+  constexpr int DY[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+  constexpr Bitboard leaper(int sq, const int *dx, const int *dy, int n) {
+    Bitboard b = 0;
+    for(int i=0;i<n;i++) {
+      int x = (sq & 7) + dx[i];
+      int y = (sq >> 3) + dy[i];
+      if(x >= 0 && x < 8 && y >= 0 && y < 8) b |= 1ULL << (y * 8 + x);
+    }
+    return b;
+  }
+
+  constexpr std::array<Bitboard, 64> buildKnight() {
+    const int dx[8] = {-2, -2, -1, 1, 2, 2, -1, 1};
+    const int dy[8] = {-1, 1, 2, 2, -1, 1, -2, -2};
+    std::array<Bitboard, 64> t{};
+    for(int sq=0;sq<64;sq++) t[sq] = leaper(sq, dx, dy, 8);
+    return t;
+  }
+
+  constexpr std::array<Bitboard, 64> buildKing() {
+    const int dx[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+    const int dy[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+    std::array<Bitboard, 64> t{};
+    for(int sq=0;sq<64;sq++) t[sq] = leaper(sq, dx, dy, 8);
+    return t;
+  }
+
+  constexpr std::array<std::array<Bitboard, 64>, 2> buildPawn() {
+    // Squares attacked by a pawn of the given color (white moves to lower y)
+    const int dx[2] = {-1, 1};
+    const int dyw[2] = {-1, -1};
+    const int dyb[2] = {1, 1};
+    std::array<std::array<Bitboard, 64>, 2> t{};
+    for(int sq=0;sq<64;sq++) {
+      t[WHITE][sq] = leaper(sq, dx, dyw, 2);
+      t[BLACK][sq] = leaper(sq, dx, dyb, 2);
+    }
+    return t;
+  }
+
+  constexpr std::array<std::array<Bitboard, 64>, 8> buildRays() {
+    std::array<std::array<Bitboard, 64>, 8> t{};
+    for(int d=0;d<8;d++) {
+      for(int sq=0;sq<64;sq++) {
+        Bitboard b = 0;
+        int x = (sq & 7) + DX[d];
+        int y = (sq >> 3) + DY[d];
+        while(x >= 0 && x < 8 && y >= 0 && y < 8) {
+          b |= 1ULL << (y * 8 + x);
+          x += DX[d];
+          y += DY[d];
+        }
+        t[d][sq] = b;
+      }
+    }
+    return t;
+  }
+
+  inline constexpr std::array<Bitboard, 64> KNIGHT = buildKnight();
+  inline constexpr std::array<Bitboard, 64> KING = buildKing();
+  inline constexpr std::array<std::array<Bitboard, 64>, 2> PAWN = buildPawn();
+  inline constexpr std::array<std::array<Bitboard, 64>, 8> RAYS = buildRays();
+
+  constexpr std::array<std::array<Bitboard, 64>, 64> buildBetween(bool line) {
+    // between: squares strictly between a and b; line: the whole line through both
+    std::array<std::array<Bitboard, 64>, 64> t{};
+    for(int a=0;a<64;a++) {
+      for(int d=0;d<8;d++) {
+        Bitboard r = RAYS[d][a];
+        while(r) {
+          int b = __builtin_ctzll(r);
+          r &= r - 1;
+          if(line) t[a][b] = RAYS[d][a] | RAYS[(d + 4) % 8][a] | (1ULL << a);
+          else t[a][b] = RAYS[d][a] & ~RAYS[d][b] & ~(1ULL << b);
+        }
+      }
+    }
+    return t;
+  }
+
+  inline constexpr std::array<std::array<Bitboard, 64>, 64> BETWEEN = buildBetween(false);
+  inline constexpr std::array<std::array<Bitboard, 64>, 64> LINE = buildBetween(true);
+
+  inline Bitboard ray(int d, int sq, Bitboard occ) {
+    Bitboard r = RAYS[d][sq];
+    Bitboard blockers = r & occ;
+    if(blockers == 0) return r;
+    int b = (d < 4 ? lsb(blockers) : msb(blockers));
+    return r ^ RAYS[d][b];
+  }
+
+  inline Bitboard rook(int sq, Bitboard occ) {
+    return ray(0, sq, occ) | ray(1, sq, occ) | ray(4, sq, occ) | ray(5, sq, occ);
+  }
+
+  inline Bitboard bishop(int sq, Bitboard occ) {
+    return ray(2, sq, occ) | ray(3, sq, occ) | ray(6, sq, occ) | ray(7, sq, occ);
+  }
+}
+
+struct Position {
+  Bitboard pieces[2][6];
+  Bitboard occupied[2];
+  Bitboard all;
+  Piece board[64];
+
+  Position();
+
+  void clear();
+  void put(int sq, Piece p);
+  void remove(int sq);
+  void set(int sq, Piece p);
+
+  Piece at(int sq) const { return board[sq]; }
+  Bitboard byType(int color, int type) const { return pieces[color][type]; }
+  int kingSquare(int color) const { return lsb(pieces[color][KING]); }
+
+  Bitboard attackersTo(int sq, Bitboard occ) const;
+  bool isAttacked(int sq, int by, Bitboard occ) const;
+  bool isAttacked(int sq, int by) const { return isAttacked(sq, by, all); }
+
+  static std::string pieceName(Piece p);
+  static Piece pieceFromName(const std::string &name);
+};
+
+#endif
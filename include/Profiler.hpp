@@ -0,0 +1,106 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+  Scoped hot-path profiler. PROFILE_SCOPE("name") at the top of a function
+  owns a static slot for that call site and adds to it the calls, the
+  elapsed clock ticks and, when hardware counters are on, the CPU cycles and
+  cache misses of the enclosing scope (inclusive of callees).
+
+  Only built with -DCHESS_PROFILE (make PROFILE=1); otherwise the macro
+  expands to nothing. Hardware counters come from perf_event_open on Linux
+  and are turned on with Profiler::enableHardware() or CHESS_PROFILE_HW=1;
+  they cost a syscall per scope, so timings are only trustworthy without them.
+*/
+
+namespace Profiler {
+#ifdef CHESS_PROFILE
+  constexpr bool ENABLED = true;
+#else
+  constexpr bool ENABLED = false;
+#endif
+
+  struct Site {
+    const char *name;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> cache_misses{0};
+    Site *next = nullptr;
+
+    explicit Site(const char *name); // Registers itself for report()
+  };
+
+  struct Counters {
+    uint64_t cycles = 0;
+    uint64_t cache_misses = 0;
+  };
+
+  extern std::atomic<bool> hardware_enabled;
+
+  inline uint64_t ticks() {
+    // TSC where there is one, a monotonic nanosecond clock elsewhere
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  bool enableHardware(); // False if the counters cannot be opened
+  Counters readHardware(); // Calling thread only
+
+  void report(std::ostream &out);
+  void reset();
+
+  class Scope {
+  private:
+    Site &site;
+    Counters hw_start;
+    uint64_t start;
+    bool hw;
+
+  public:
+    explicit Scope(Site &s): site(s), hw(hardware_enabled.load(std::memory_order_relaxed)) {
+      if(hw) hw_start = readHardware();
+      start = ticks();
+    }
+
+    ~Scope() {
+      uint64_t elapsed = ticks() - start;
+      site.calls.fetch_add(1, std::memory_order_relaxed);
+      site.ticks.fetch_add(elapsed, std::memory_order_relaxed);
+      if(hw) {
+        Counters now = readHardware();
+        site.cycles.fetch_add(now.cycles - hw_start.cycles, std::memory_order_relaxed);
+        site.cache_misses.fetch_add(now.cache_misses - hw_start.cache_misses, std::memory_order_relaxed);
+      }
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef CHESS_PROFILE
+#define PROFILE_SCOPE(name) \
+  static Profiler::Site PROFILE_CONCAT(profile_site_, __LINE__)(name); \
+  Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_site_, __LINE__))
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <Game.hpp>
+
+/*
+  Endgame tables: every position of a material (KQvK, KRvKP, ...) with its
+  outcome for the side to move and the distance to mate. Built offline by
+  tools/tbgen.cpp, memory mapped and read in place.
+
+  A material is named strong side first, the side with more material (by
+  Evaluation::VALUE, then by its best pieces). Positions are stored with
+  the strong side as white: a position where it is black is flipped
+  vertically with the colours swapped. Equal sides are never swapped. The
+  strong king is mirrored onto files a-d, then
+
+    index = ((stm * 32 + strong king) * 64 + weak king) * 64 + ...
+
+  over the other pieces, strong then weak, queens to pawns, identical
+  pieces in increasing square order. stm is 0 with the strong side to move.
+
+  One byte per position: DRAW, 1..127 the side to move mates in that many
+  moves, LOSS + m it is mated in m moves (LOSS itself: checkmated).
+  Indices that are not a legal position (overlapping pieces, the side not
+  to move in check, identical pieces out of order) hold DRAW. Castling and
+  en passant are left out: positions with either right are not probed.
+
+  The file: "CHTB", uint32 version, uint64 entries, then the entries.
+*/
+namespace Tablebase {
+  const int MAX_MEN = 5;
+  const int KING_SQUARES = 32; // Strong king on files a-d
+  const uint32_t VERSION = 1;
+  const int HEADER_SIZE = 16;
+
+  const uint8_t DRAW = 0;
+  const uint8_t LOSS = 128;
+
+  // Search scores for table results: below a mate, above any evaluation
+  const double WIN_SCORE = 500.0;
+  const double PLY_SCORE = 0.1;
+
+  inline bool isWin(uint8_t v) { return v >= 1 && v < LOSS; }
+  inline bool isLoss(uint8_t v) { return v >= LOSS; }
+  inline int plies(uint8_t v) { return isWin(v) ? 2 * v - 1 : isLoss(v) ? 2 * (v - LOSS) : 0; }
+  inline uint8_t fromPlies(int plies) { return plies % 2 == 1 ? (plies + 1) / 2 : LOSS + plies / 2; } // Odd wins, even losses
+
+  struct Material {
+    int count[2][6]; // Strong side then weak side, by PieceType
+    int men;
+
+    uint32_t key() const; // Packed counts, for looking tables up
+    std::string name() const;
+    uint64_t size() const;
+    static Material of(const Position &pos, bool &swap); // swap: the strong side is black in pos
+    static bool parse(const std::string &name, Material &m); // Any side order, m comes out canonical
+  };
+
+  uint64_t index(const Position &pos, int stm, bool swap);
+  bool decode(uint64_t index, const Material &m, Position &pos, int &stm); // false: not a legal position
+}
+
+class EndgameTables {
+private:
+  struct Table {
+    const uint8_t *data; // Past the header
+    uint64_t mapped;
+  };
+
+  std::map<uint32_t, Table> tables; // By Material::key()
+  int max_men;
+
+public:
+  EndgameTables();
+  ~EndgameTables();
+  EndgameTables(const EndgameTables &) = delete;
+  EndgameTables &operator=(const EndgameTables &) = delete;
+
+  bool open(const std::string &dir, std::string &error); // Every *.tb file in dir
+  void close();
+  int size() const { return tables.size(); }
+  int maxMen() const { return max_men; } // 0 without tables
+
+  bool probe(const Position &pos, int stm, uint8_t &value) const; // false: no table for the material
+  bool probe(Game &game, double &score) const; // score from white's view, false when not covered
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+enum Bound : uint8_t {
+  BOUND_NONE = 0,
+  BOUND_EXACT = 1,
+  BOUND_LOWER = 2, // score >= stored value (fail high)
+  BOUND_UPPER = 3  // score <= stored value (fail low)
+};
+
+struct TTEntry {
+  uint64_t key;
+  float score;
+  uint16_t move;
+  int8_t depth;
+  uint8_t genBound; // generation << 2 | bound
+
+  Bound bound() const { return Bound(genBound & 3); }
+  uint8_t generation() const { return genBound >> 2; }
+};
+
+struct TTStats {
+  // Kept by each searching thread, so the table itself has no shared counters
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t collisions = 0;
+  uint64_t stores = 0;
+
+  TTStats &operator+=(const TTStats &o) {
+    hits += o.hits;
+    misses += o.misses;
+    collisions += o.collisions;
+    stores += o.stores;
+    return *this;
+  }
+};
+
+/*
+  Shared by every search thread without locks. A slot is two relaxed 64-bit
+  words: the entry data and key ^ data. A slot torn by two writers no longer
+  decodes to its key, so it reads as a miss instead of a wrong entry.
+*/
+class TranspositionTable {
+private:
+  static const int BUCKET_SIZE = 2;
+
+  struct Slot {
+    std::atomic<uint64_t> check; // key ^ data
+    std::atomic<uint64_t> data;  // score bits, move, depth, genBound
+  };
+
+  std::unique_ptr<Slot[]> table;
+  uint64_t size;
+  uint64_t mask;
+  uint8_t generation;
+
+  Slot *bucket(uint64_t key) const;
+  static uint64_t pack(const TTEntry &e);
+  static TTEntry unpack(uint64_t key, uint64_t data);
+  static bool read(const Slot &slot, TTEntry &entry);
+
+public:
+  TranspositionTable(int size_mb = 16);
+
+  void resize(int size_mb);
+  void clear();
+  void newSearch();
+
+  bool probe(uint64_t key, TTEntry &entry, TTStats &stats) const;
+  void store(uint64_t key, int depth, Bound bound, double score, uint16_t move, TTStats &stats);
+
+  int hashfull() const;
+  void report(const TTStats &stats) const;
+};
+
+#endif
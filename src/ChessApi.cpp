@@ -0,0 +1,228 @@
+#include <ChessApi.h>
+#include <Engine.hpp>
+
+#include <cstring>
+
+struct chess_engine {
+  Engine engine;
+  std::string error;
+
+  // The position set last, put back after a batch
+  std::string fen;
+  std::vector<Move> moves;
+
+  chess_engine(int hash_mb, int tree_mb) : engine(hash_mb, tree_mb) {}
+};
+
+namespace {
+  const char *START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  int fail(chess_engine *e, int code, const std::string &message) {
+    e->error = message;
+    return code;
+  }
+
+  template<typename F>
+  int guarded(chess_engine *e, F f) {
+    // Nothing may unwind into C callers
+    if(e == nullptr) return CHESS_INVALID_ARGUMENT;
+    try {
+      e->error.clear();
+      return f();
+    } catch(const std::exception &ex) {
+      return fail(e, CHESS_INTERNAL_ERROR, ex.what());
+    } catch(...) {
+      return fail(e, CHESS_INTERNAL_ERROR, "unknown error");
+    }
+  }
+
+  bool toLimits(const chess_limits *in, SearchLimits &out) {
+    // At least one limit, or the search would run to depth 64
+    if(in->depth < 0 || in->move_time < 0) return false;
+    if(in->depth == 0 && in->move_time == 0 && in->nodes == 0) return false;
+    if(in->depth > 0) out.depth = in->depth;
+    out.move_time = in->move_time;
+    out.nodes = in->nodes;
+    return true;
+  }
+
+  void clearResult(chess_result *out, int status) {
+    memset(out, 0, sizeof(*out));
+    out->status = status;
+  }
+
+  void fillResult(const SearchResult &r, chess_result *out) {
+    clearResult(out, CHESS_OK);
+    if(r.move != MOVE_NONE) strncpy(out->move, moveToString(r.move).c_str(), sizeof(out->move) - 1);
+    out->score = r.score;
+    out->depth = r.depth;
+    out->nodes = r.nodes;
+    out->seconds = r.seconds;
+  }
+
+  void restorePosition(chess_engine *e) {
+    e->engine.setPosition(e->fen, false);
+    for(Move m: e->moves) e->engine.moveDone(m);
+  }
+}
+
+extern "C" {
+
+int chess_api_version(void) {
+  return CHESS_API_VERSION;
+}
+
+chess_engine *chess_engine_new(int hash_mb, int tree_mb) {
+  if(hash_mb < 0 || tree_mb < 0) return nullptr;
+  try {
+    chess_engine *e = new chess_engine(hash_mb > 0 ? hash_mb : 64, tree_mb > 0 ? tree_mb : 256);
+    e->engine.setVerbose(false);
+    e->fen = START_FEN;
+    e->engine.setPosition(e->fen);
+    return e;
+  } catch(...) {
+    return nullptr;
+  }
+}
+
+void chess_engine_free(chess_engine *engine) {
+  delete engine;
+}
+
+const char *chess_last_error(const chess_engine *engine) {
+  if(engine == nullptr) return "no engine";
+  return engine->error.c_str();
+}
+
+int chess_set_threads(chess_engine *engine, int threads) {
+  return guarded(engine, [&]() {
+    if(threads < 1) return fail(engine, CHESS_INVALID_ARGUMENT, "threads must be at least 1");
+    engine->engine.setThreads(threads);
+    return CHESS_OK;
+  });
+}
+
+int chess_set_seed(chess_engine *engine, uint32_t seed) {
+  return guarded(engine, [&]() {
+    engine->engine.setSeed(seed);
+    return CHESS_OK;
+  });
+}
+
+int chess_load_network(chess_engine *engine, const char *path) {
+  return guarded(engine, [&]() {
+    std::shared_ptr<Nnue::Network> network;
+    if(path != nullptr) {
+      std::string error;
+      network = std::make_shared<Nnue::Network>();
+      if(!network->load(path, error)) return fail(engine, CHESS_LOAD_FAILED, error);
+    }
+    engine->engine.setNetwork(network);
+    return CHESS_OK;
+  });
+}
+
+int chess_load_book(chess_engine *engine, const char *path) {
+  return guarded(engine, [&]() {
+    std::shared_ptr<OpeningBook> book;
+    if(path != nullptr) {
+      std::string error;
+      book = std::make_shared<OpeningBook>();
+      if(!book->open(path, error)) return fail(engine, CHESS_LOAD_FAILED, error);
+    }
+    engine->engine.setBook(book);
+    return CHESS_OK;
+  });
+}
+
+int chess_load_tablebase(chess_engine *engine, const char *dir) {
+  return guarded(engine, [&]() {
+    std::shared_ptr<EndgameTables> tablebase;
+    if(dir != nullptr) {
+      std::string error;
+      tablebase = std::make_shared<EndgameTables>();
+      if(!tablebase->open(dir, error)) return fail(engine, CHESS_LOAD_FAILED, error);
+    }
+    engine->engine.setTablebase(tablebase);
+    return CHESS_OK;
+  });
+}
+
+int chess_set_position(chess_engine *engine, const char *fen, const char *const *moves, int move_count) {
+  return guarded(engine, [&]() {
+    if(move_count < 0 || (move_count > 0 && moves == nullptr)) {
+      return fail(engine, CHESS_INVALID_ARGUMENT, "no moves given");
+    }
+    std::string start = (fen != nullptr ? fen : START_FEN);
+    std::string error;
+    if(!Game::isValidFen(start, error)) return fail(engine, CHESS_INVALID_POSITION, error);
+
+    // Every move is checked before the engine sees any
+    Game game(start);
+    std::vector<Move> played;
+    for(int i=0;i<move_count;i++) {
+      Move m = (moves[i] != nullptr ? game.getMove(moves[i]) : MOVE_NONE);
+      if(m == MOVE_NONE) {
+        return fail(engine, CHESS_ILLEGAL_MOVE, "move " + std::to_string(i + 1) + " ("
+          + (moves[i] != nullptr ? moves[i] : "null") + ") is not legal");
+      }
+      game.doAction(m);
+      played.push_back(m);
+    }
+
+    engine->fen = start;
+    engine->moves = played;
+    restorePosition(engine);
+    return CHESS_OK;
+  });
+}
+
+int chess_search(chess_engine *engine, const chess_limits *limits, chess_result *result) {
+  return guarded(engine, [&]() {
+    SearchLimits l;
+    if(limits == nullptr || result == nullptr) return fail(engine, CHESS_INVALID_ARGUMENT, "no limits or no result");
+    if(!toLimits(limits, l)) return fail(engine, CHESS_INVALID_ARGUMENT, "limits need a positive depth, time or node count");
+    engine->engine.getNextMove(l);
+    fillResult(engine->engine.getLastSearch(), result);
+    return CHESS_OK;
+  });
+}
+
+int chess_evaluate_batch(chess_engine *engine, const char *const *fens, int count,
+  const chess_limits *limits, chess_result *results) {
+  return guarded(engine, [&]() {
+    SearchLimits l;
+    if(count < 0 || (count > 0 && (fens == nullptr || results == nullptr))) {
+      return fail(engine, CHESS_INVALID_ARGUMENT, "no positions or no results");
+    }
+    if(limits != nullptr && !toLimits(limits, l)) {
+      return fail(engine, CHESS_INVALID_ARGUMENT, "limits need a positive depth, time or node count");
+    }
+
+    int status = CHESS_OK;
+    for(int i=0;i<count;i++) {
+      std::string error = "null FEN";
+      if(fens[i] == nullptr || !Game::isValidFen(fens[i], error)) {
+        clearResult(&results[i], CHESS_INVALID_POSITION);
+        if(status == CHESS_OK) fail(engine, CHESS_INVALID_POSITION, "position " + std::to_string(i) + ": " + error);
+        status = CHESS_INVALID_POSITION;
+        continue;
+      }
+
+      // One engine for the whole batch: its tables and threads are set up once
+      engine->engine.setPosition(fens[i], false);
+      if(limits == nullptr) {
+        clearResult(&results[i], CHESS_OK);
+        results[i].score = engine->engine.getStaticScore();
+      } else {
+        engine->engine.getNextMove(l);
+        fillResult(engine->engine.getLastSearch(), &results[i]);
+      }
+    }
+
+    restorePosition(engine);
+    return status;
+  });
+}
+
+}
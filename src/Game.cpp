@@ -1,39 +1,195 @@
 #include <Game.hpp>
+#include <Evaluation.hpp>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
+#include <sstream>
+
+// pieces_counter slot of each piece type (p, n, b, r, q, k) for white; black adds 6
+const int counter_pos[6] = {5, 1, 2, 0, 4, -1};
+
+int castlingTouch(int sq) {
+  // Castling rights lost when a piece leaves or enters sq
+  if(sq == makeSquare(0, 7)) return 1;
+  if(sq == makeSquare(7, 7)) return 2;
+  if(sq == makeSquare(4, 7)) return 3;
+  if(sq == makeSquare(0, 0)) return 4;
+  if(sq == makeSquare(7, 0)) return 8;
+  if(sq == makeSquare(4, 0)) return 12;
+  return 0;
+}
 
-std::map<std::string, int> piece_pos = {
-  {"wr", 0}, {"wn", 1}, {"wb", 2}, {"wq", 4}, {"wp", 5},
-  {"br", 6}, {"bn", 7}, {"bb", 8}, {"bq", 10}, {"bp", 11},
-  {"", -1}, {"wk", -1}, {"bk", -1}
-};
+int counterIndex(Piece p, int sq) {
+  if(p == NO_PIECE) return -1;
+  int id = counter_pos[pieceType(p)];
+  if(id == -1) return -1;
+  if(id == 2) id += (squareX(sq)%2 + squareY(sq)%2)%2;
+  return id + 6 * pieceColor(p);
+}
 
 Game::Game() {
+  first_ply = 0;
   buildBoard();
 
   GameState gs;
-  gs.gameStatus = "alive";
   gs.enPassant = {-1, -1};
   gs.castlingPreserved = 0;
-  gs.gameScore = 0.0;
-  gs.moves_white = 0;
-  gs.moves_black = 0;
-  gs.repetition = false;
-  gs.pieces_counter.resize(12, 0);
+  setupState(gs);
+}
 
-  for(int i=0;i<8;i++) {
-    for(int j=0;j<8;j++) {
-      int id = piece_pos[board[i][j]];
-      if(id == -1) continue;
-      if(id == 2 || id == 8) {
-        id += (i%2 + j%2)%2;
+Game::Game(const std::string &fen) {
+  // Only the placement, side to move, castling and en passant fields are used
+  std::istringstream in(fen);
+  std::string placement, turn = "w", castling = "-", en_passant = "-";
+  in >> placement >> turn >> castling >> en_passant;
+
+  position.clear();
+  int x = 0, y = 0;
+  for(char c: placement) {
+    if(c == '/') {
+      x = 0;
+      y++;
+    } else if(c >= '1' && c <= '8') {
+      x += c - '0';
+    } else {
+      const std::string types = "pnbrqk";
+      size_t type = types.find(std::tolower(c));
+      assert(type != std::string::npos && x < 8 && y < 8);
+      position.put(makeSquare(x, y), makePiece(std::isupper(c) ? WHITE : BLACK, type));
+      x++;
+    }
+  }
+  assert(popCount(position.byType(WHITE, KING)) == 1 && popCount(position.byType(BLACK, KING)) == 1);
+  first_ply = (turn == "b" ? 1 : 0);
+
+  GameState gs;
+  gs.castlingPreserved = 15;
+  for(char c: castling) {
+    if(c == 'Q') gs.castlingPreserved ^= 1;
+    else if(c == 'K') gs.castlingPreserved ^= 2;
+    else if(c == 'q') gs.castlingPreserved ^= 4;
+    else if(c == 'k') gs.castlingPreserved ^= 8;
+  }
+
+  // FEN gives the square behind the pawn, GameState keeps the pawn itself
+  gs.enPassant = {-1, -1};
+  if(en_passant != "-" && en_passant.size() == 2) {
+    int ep_x = en_passant[0] - 'a';
+    int ep_y = '8' - en_passant[1];
+    gs.enPassant = {ep_x, (ep_y == 2 ? 3 : 4)};
+  }
+  setupState(gs);
+}
+
+bool Game::isValidFen(const std::string &fen, std::string &error) {
+  // Everything the constructor asserts or trusts, checked before it runs
+  std::istringstream in(fen);
+  std::string placement, turn = "w", castling = "-", en_passant = "-";
+  in >> placement >> turn >> castling >> en_passant;
+
+  Position position;
+  int x = 0, y = 0;
+  for(char c: placement) {
+    if(c == '/') {
+      if(x != 8) break;
+      x = 0;
+      y++;
+    } else if(c >= '1' && c <= '8') {
+      x += c - '0';
+    } else {
+      const std::string types = "pnbrqk";
+      size_t type = types.find(std::tolower(c));
+      if(type == std::string::npos || x >= 8 || y >= 8) {
+        error = "bad piece placement";
+        return false;
       }
-      gs.pieces_counter[id]++;
+      position.put(makeSquare(x, y), makePiece(std::isupper(c) ? WHITE : BLACK, type));
+      x++;
     }
+    if(x > 8) break;
+  }
+  if(x != 8 || y != 7) {
+    error = "the placement is not 8 ranks of 8 squares";
+    return false;
+  }
+  if(popCount(position.byType(WHITE, KING)) != 1 || popCount(position.byType(BLACK, KING)) != 1) {
+    error = "each side needs exactly one king";
+    return false;
   }
+  const Bitboard back_ranks = 0xff000000000000ffULL;
+  if((position.byType(WHITE, PAWN) | position.byType(BLACK, PAWN)) & back_ranks) {
+    error = "pawns on a back rank";
+    return false;
+  }
+  if(turn != "w" && turn != "b") {
+    error = "the side to move is not w or b";
+    return false;
+  }
+  int us = (turn == "w" ? WHITE : BLACK);
+  if(position.isAttacked(position.kingSquare(us ^ 1), us)) {
+    error = "the side not to move is in check";
+    return false;
+  }
+
+  // Rights need the king and the rook still on their squares
+  const std::string rights = "KQkq";
+  for(char c: castling) {
+    if(castling == "-") break;
+    size_t id = rights.find(c);
+    if(id == std::string::npos) {
+      error = "bad castling field";
+      return false;
+    }
+    int color = (id < 2 ? WHITE : BLACK);
+    int row = (color == WHITE ? 7 : 0);
+    if(position.at(makeSquare(4, row)) != makePiece(color, KING)
+      || position.at(makeSquare(id % 2 == 0 ? 7 : 0, row)) != makePiece(color, ROOK)) {
+      error = std::string("castling right ") + c + " without its king and rook";
+      return false;
+    }
+  }
+
+  if(en_passant != "-") {
+    // The pawn that just moved two squares has to be there
+    int row = (us == WHITE ? 3 : 4);
+    int ep_x = (en_passant.size() == 2 ? en_passant[0] - 'a' : -1);
+    if(ep_x < 0 || ep_x > 7 || en_passant[1] != (us == WHITE ? '6' : '3')
+      || position.at(makeSquare(ep_x, row)) != makePiece(us ^ 1, PAWN)) {
+      error = "bad en passant square";
+      return false;
+    }
+  }
+  return true;
+}
+
+void Game::setupState(GameState gs) {
+  // Resolved like a position reached by a move
+  gs.gameStatus = "unknown";
+  gs.material = gs.psq_mg = gs.psq_eg = 0;
+  gs.moves_white = 0;
+  gs.moves_black = 0;
+  gs.repetition = false;
+  gs.reversible_moves = 0;
+  gs.pieces_counter.fill(0);
+
+  for(int sq=0;sq<64;sq++) {
+    addPiece(gs, position.at(sq), sq, 1);
+    int id = counterIndex(position.at(sq), sq);
+    if(id == -1) continue;
+    gs.pieces_counter[id]++;
+  }
+  gs.gameScore = evaluateState(gs, isWhiteTurn());
+  gs.scored = true;
+  if(drawConditions(gs)) {
+    gs.gameStatus = "draw";
+    gs.gameScore = 0.0;
+  }
+  gs.key = computeKey(gs);
 
   addState(gs);
-  genNextMoves(gs);
+  nextMoves.resize(1);
+  nextMovesReady.push_back(false);
+  resolveStatus(); // A single position: its mate or stalemate is settled now, static scores included
 }
 
 GameState Game::getState() const {
@@ -45,39 +201,64 @@ void Game::addState(GameState gs) {
 }
 
 bool Game::isWhiteTurn() const {
-  return ((int)moves.size() % 2) == 0;
+  return ((int)moves.size() + first_ply) % 2 == 0;
 }
 
 std::vector<std::vector<std::string>> Game::getBoard(int move_id) {
   if(move_id == -1) move_id = moves.size();
 
-  std::vector<std::vector<std::string>> tmp = board;
+  Piece tmp[64];
+  for(int sq=0;sq<64;sq++) tmp[sq] = position.at(sq);
 
   for(int i=(int)moves.size() - 1; i>=move_id; i--) {
-    for(auto &c: moves[i]) {
-      tmp[c.first.first][c.first.second] = c.second;
+    for(int j=0;j<moves[i].count;j++) {
+      tmp[moves[i].square[j]] = moves[i].piece[j];
     }
   }
 
-  return tmp;
+  std::vector<std::vector<std::string>> setup(8, std::vector<std::string>(8));
+  for(int sq=0;sq<64;sq++) {
+    setup[squareX(sq)][squareY(sq)] = Position::pieceName(tmp[sq]);
+  }
+
+  return setup;
 }
 
-std::string Game::getBoardHash() {
-  std::string hsh = "";
-  for(int i=0;i<8;i++) {
-    for(int j=0;j<8;j++) {
-      if(board[i][j] == "") hsh += "xx";
-      else hsh += board[i][j];
-    }
+uint64_t Game::castlingKey(const GameState &gs) const {
+  uint64_t key = 0;
+  for(int id=0;id<4;id++) {
+    if(gs.isCastlingPreserved(id)) key ^= Zobrist::castling(id);
   }
+  return key;
+}
+
+uint64_t Game::enPassantKey(const GameState &gs) const {
+  // Only hashed when the side to move has a pawn next to the double-pushed one
+  if(gs.enPassant.first == -1) return 0;
+  int victim = makeSquare(gs.enPassant.first, gs.enPassant.second);
+  Piece pawn = position.at(victim);
+  int them = pieceColor(pawn) ^ 1;
+  Bitboard neighbours = Attacks::KING[victim] & (Attacks::RAYS[0][victim] | Attacks::RAYS[4][victim]);
+  if((neighbours & position.byType(them, PAWN)) == 0) return 0;
+  return Zobrist::enPassant(gs.enPassant.first);
+}
 
-  return hsh;
+uint64_t Game::computeKey(const GameState &gs) const {
+  uint64_t key = 0;
+  for(int sq=0;sq<64;sq++) key ^= Zobrist::piece(position.at(sq), sq);
+  key ^= castlingKey(gs);
+  key ^= enPassantKey(gs);
+  if(isWhiteTurn()) key ^= Zobrist::turn();
+  return key;
 }
 
-int Game::storeHashedBoard() {
-  const std::string &hsh = getBoardHash();
-  hashedBoardCounter[hsh]++;
-  return hashedBoardCounter[hsh];
+bool Game::isRepetition(const GameState &gs) const {
+  // Only positions since the last capture or pawn move, with the same side to move, can repeat
+  int count = 1;
+  for(int i=(int)gameState.size() - 2, k=2; i>=0 && k<=gs.reversible_moves; i-=2, k+=2) {
+    if(gameState[i].key == gs.key) count++;
+  }
+  return count >= 3;
 }
 
 std::vector<std::pair<pii, int>> Game::getSpecialCells(pii cell) {
@@ -88,8 +269,12 @@ std::vector<std::pair<pii, int>> Game::getSpecialCells(pii cell) {
   } else if(isCheckMate()) {
     cells.push_back({getKingPos(isWhiteTurn()), 1});
   } else {
-    for(int i=0;i<nextMoves.size();i++) {
-      if(nextMoves[i].first == cell) cells.push_back({nextMoves[i].second, 0});
+    const auto &next_moves = getNextMoves();
+    for(Move m: next_moves) {
+      if(moveChoose(m) > 0) continue; // One highlight per promotion square
+      if(moveFrom(m) == makeSquare(cell.first, cell.second)) {
+        cells.push_back({{squareX(moveTo(m)), squareY(moveTo(m))}, 0});
+      }
     }
     if(hasMoveFor(cell)) cells.push_back({cell, 2});
   }
@@ -97,530 +282,494 @@ std::vector<std::pair<pii, int>> Game::getSpecialCells(pii cell) {
 }
 
 pii Game::getKingPos(bool white) {
-  std::string king = (white ? "wk" : "bk");
-
-  int king_x = -1, king_y = -1;
-  for(int i=0;i<8 && king_x == -1;i++) {
-    for(int j=0;j<8 && king_x == -1;j++) {
-      if(board[i][j] == king) {
-        king_x = i;
-        king_y = j;
-      }
-    }
-  }
-  assert(king_x != -1);
-  return {king_x, king_y};
+  Bitboard king = position.byType(white ? WHITE : BLACK, KING);
+  assert(king != 0);
+  int sq = lsb(king);
+  return {squareX(sq), squareY(sq)};
 }
 
-bool Game::isDraw() const {
+bool Game::isDraw() {
+  resolveStatus();
   return getState().gameStatus == "draw";
 }
 
-bool Game::isCheckMate() const {
+bool Game::isCheckMate() {
+  resolveStatus();
   return getState().gameStatus == "checkmate";
 }
 
+void Game::resolveStatus() {
+  // Mate and stalemate need the legal moves, so they are only decided when asked for
+  if(gameState.back().gameStatus != "unknown") return;
+
+  int total_moves = getNextMoves().size();
+  GameState &gs = gameState.back();
+  if(isWhiteTurn()) gs.moves_white = total_moves;
+  else gs.moves_black = total_moves;
+
+  gs.gameStatus = "alive";
+  if(total_moves == 0 && isOnCheck()) {
+    gs.gameStatus = "checkmate";
+    if(isWhiteTurn()) gs.gameScore = -1000;
+    else gs.gameScore = 1000;
+    gs.scored = true;
+  } else if(total_moves == 0) {
+    // Stalemate
+    gs.gameStatus = "draw";
+    gs.gameScore = 0.0;
+    gs.scored = true;
+  }
+}
+
 void Game::buildBoard() {
-  for(int i=0;i<8;i++) {
-    std::vector<std::string> row;
-    for(int j=0;j<8;j++) {
-      row.push_back("");
-    }
-    board.push_back(row);
-  }
-
-  board[0][0] = "br";
-  board[1][0] = "bn";
-  board[2][0] = "bb";
-  board[3][0] = "bq";
-  board[4][0] = "bk";
-  board[5][0] = "bb";
-  board[6][0] = "bn";
-  board[7][0] = "br";
-  board[0][7] = "wr";
-  board[1][7] = "wn";
-  board[2][7] = "wb";
-  board[3][7] = "wq";
-  board[4][7] = "wk";
-  board[5][7] = "wb";
-  board[6][7] = "wn";
-  board[7][7] = "wr";
+  position.clear();
 
+  const int back_rank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
   for(int i=0;i<8;i++) {
-    board[i][1] = "bp";
-    board[i][6] = "wp";
+    position.put(makeSquare(i, 0), makePiece(BLACK, back_rank[i]));
+    position.put(makeSquare(i, 1), makePiece(BLACK, PAWN));
+    position.put(makeSquare(i, 6), makePiece(WHITE, PAWN));
+    position.put(makeSquare(i, 7), makePiece(WHITE, back_rank[i]));
   }
-  storeHashedBoard();
 }
 
-std::string Game::getPositionInfo(int x, int y) const {
-  if(x < 0 || x > 7 || y < 0 || y > 7) return "out";
-  return board[x][y];
+Piece Game::getPositionInfo(int x, int y) const {
+  assert(x >= 0 && x <= 7 && y >= 0 && y <= 7);
+  return position.at(makeSquare(x, y));
 }
 
 bool Game::isOnCheck() {
-  std::clock_t t = std::clock();
-  pii king_pos = getKingPos(isWhiteTurn());
-  int king_x = king_pos.first;
-  int king_y = king_pos.second;
-
-  // Checked by a Pawn
-  if(isWhiteTurn()) {
-    if(getPositionInfo(king_x-1, king_y-1) == "bp" || getPositionInfo(king_x+1, king_y-1) == "bp") return true;
-  } else {
-    if(getPositionInfo(king_x-1, king_y+1) == "wp" || getPositionInfo(king_x+1, king_y+1) == "wp") return true;
-  }
+  PROFILE_SCOPE("isOnCheck");
+  int us = (isWhiteTurn() ? WHITE : BLACK);
+  bool check = position.isAttacked(position.kingSquare(us), us ^ 1);
+  return check;
+}
 
-  // Checked by a King
-  int dl1[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-  int dc1[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-  for(int i=0;i<8;i++) {
-    std::string info = getPositionInfo(king_x + dl1[i], king_y + dc1[i]);
-    if(isWhiteTurn() && info == "bk") return true;
-    if(!isWhiteTurn() && info == "wk") return true;
+Bitboard Game::pinnedPieces(int us) const {
+  // Own pieces standing alone between our king and an enemy slider
+  int them = us ^ 1;
+  int king_sq = position.kingSquare(us);
+  Bitboard snipers = (Attacks::rook(king_sq, 0) & (position.byType(them, ROOK) | position.byType(them, QUEEN)))
+    | (Attacks::bishop(king_sq, 0) & (position.byType(them, BISHOP) | position.byType(them, QUEEN)));
+
+  Bitboard pinned = 0;
+  while(snipers) {
+    int sq = popLsb(snipers);
+    Bitboard blockers = Attacks::BETWEEN[king_sq][sq] & position.all;
+    if(popCount(blockers) == 1) pinned |= blockers & position.occupied[us];
   }
-
-  // Checked by a Knight
-  int dl2[] = {-2, -2, -1, 1, 2, 2, -1, 1};
-  int dc2[] = {-1, 1, 2, 2, -1, 1, -2, -2};
-  for(int i=0;i<8;i++) {
-    std::string info = getPositionInfo(king_x + dl2[i], king_y + dc2[i]);
-    if(isWhiteTurn() && info == "bn") return true;
-    if(!isWhiteTurn() && info == "wn") return true;
-  }
-
-  // Checked by a Bishop / Queen
-  int dl3[] = {-1, -1, 1, 1};
-  int dc3[] = {-1, 1, 1, -1};
-  for(int i=0;i<4;i++) {
-    int t_king_x = king_x + dl3[i];
-    int t_king_y = king_y + dc3[i];
-
-    std::string info = getPositionInfo(t_king_x, t_king_y);
-    while(info == "") {
-      t_king_x += dl3[i];
-      t_king_y += dc3[i];
-      info = getPositionInfo(t_king_x, t_king_y);
-    }
-    if(isWhiteTurn() && (info == "bb" || info == "bq")) return true;
-    if(!isWhiteTurn() && (info == "wb" || info == "wq")) return true;
-  }
-
-  // Checked by a Rook / Queen
-  int dl4[] = {-1, 0, 1, 0};
-  int dc4[] = {0, -1, 0, 1};
-  for(int i=0;i<4;i++) {
-    int t_king_x = king_x + dl4[i];
-    int t_king_y = king_y + dc4[i];
-
-    std::string info = getPositionInfo(t_king_x, t_king_y);
-    while(info == "") {
-      t_king_x += dl4[i];
-      t_king_y += dc4[i];
-      info = getPositionInfo(t_king_x, t_king_y);
-    }
-    if(isWhiteTurn() && (info == "br" || info == "bq")) return true;
-    if(!isWhiteTurn() && (info == "wr" || info == "wq")) return true;
-  }
-  t = (std::clock() - t);
-  elapsed_sec["isOnCheck"] += ((double)t/CLOCKS_PER_SEC) * 1000.0;
-  called_counter["isOnCheck"]++;
-  return false;
+  return pinned;
 }
 
-bool Game::isValidMove(pii curr_pos, pii new_pos) {
-  std::string current_pos_before = getPositionInfo(curr_pos.first, curr_pos.second);
-  std::string new_pos_before = getPositionInfo(new_pos.first, new_pos.second);
-
-  if(new_pos_before == "out") return false;
-  if(isWhiteTurn() && (new_pos_before != "" && new_pos_before[0] == 'w')) return false;
-  if(!isWhiteTurn() && (new_pos_before != "" && new_pos_before[0] == 'b')) return false;
-
-  // Move the piece
-  board[curr_pos.first][curr_pos.second] = "";
-  board[new_pos.first][new_pos.second] = current_pos_before;
-
-  bool isValid = !isOnCheck();
-
-  // Rollback board
-  board[curr_pos.first][curr_pos.second] = current_pos_before;
-  board[new_pos.first][new_pos.second] = new_pos_before;
-
-  return isValid;
+std::vector<Move> &Game::getNextMoves() {
+  int ply = moves.size();
+  if(!nextMovesReady[ply]) {
+    genNextMoves(getState());
+    nextMovesReady[ply] = true;
+  }
+  return nextMoves[ply];
 }
 
-void Game::genNextMoves(const GameState gs) {
-  std::clock_t t = std::clock();
-  nextMoves.clear();
-
-  std::vector<std::pair<std::string, pii>> setup;
-  for(int i=0;i<8;i++) {
-    for(int j=0;j<8;j++) {
-      if(board[i][j] == "") continue;
-      setup.push_back({board[i][j], {i, j}});
+void Game::genNextMoves(const GameState &gs) {
+  PROFILE_SCOPE("genNextMoves");
+  std::vector<Move> &next_moves = nextMoves[moves.size()];
+  next_moves.clear();
+
+  int us = (isWhiteTurn() ? WHITE : BLACK);
+  int them = us ^ 1;
+  Bitboard own = position.occupied[us];
+  Bitboard enemy = position.occupied[them];
+  Bitboard empty = ~position.all;
+
+  auto addMove = [&](int from, int to, int flag = MOVE_NORMAL) {
+    next_moves.push_back(makeMove(from, to, flag));
+  };
+  auto addPawnMove = [&](int from, int to) {
+    if(squareY(to) != 0 && squareY(to) != 7) {
+      addMove(from, to);
+      return;
     }
+    for(int choose=0;choose<4;choose++) next_moves.push_back(makeMove(from, to, MOVE_PROMOTION, choose));
+  };
+
+  int king_sq = position.kingSquare(us);
+  Bitboard checkers = position.attackersTo(king_sq, position.all) & enemy;
+
+  // King moves: the king itself must not block the slider checking it
+  Bitboard occ_without_king = position.all ^ squareBB(king_sq);
+  Bitboard king_targets = Attacks::KING[king_sq] & ~own;
+  while(king_targets) {
+    int to = popLsb(king_targets);
+    if(!position.isAttacked(to, them, occ_without_king)) addMove(king_sq, to);
   }
 
-  for(int i=0;i<setup.size();i++) {
-    if(isWhiteTurn() && setup[i].first[0] == 'b') continue;
-    if(!isWhiteTurn() && setup[i].first[0] == 'w') continue;
-
-    pii current_pos = setup[i].second;
-
-    if(setup[i].first[1] == 'n') {
-      // Knight moves
-      int dl[] = {-2, -2, -1, 1, 2, 2, -1, 1};
-      int dc[] = {-1, 1, 2, 2, -1, 1, -2, -2};
-      for(int j=0;j<8;j++) {
-        pii new_pos = setup[i].second;
-        new_pos.first += dl[j];
-        new_pos.second += dc[j];
-
-        if(isValidMove(current_pos, new_pos)) {
-          nextMoves.push_back({current_pos, new_pos});
+  // Single check: capture the checker or block the ray
+  Bitboard check_mask = ~0ULL;
+  if(checkers) {
+    int checker = lsb(checkers);
+    check_mask = checkers | Attacks::BETWEEN[king_sq][checker];
+  }
+  Bitboard pinned = pinnedPieces(us);
+
+  // Double check: only the king can move
+  Bitboard setup = (popCount(checkers) > 1 ? 0 : own ^ squareBB(king_sq));
+  while(setup) {
+    int from = popLsb(setup);
+    int type = pieceType(position.at(from));
+
+    Bitboard targets = 0;
+    if(type == KNIGHT) targets = Attacks::KNIGHT[from];
+    else if(type == BISHOP) targets = Attacks::bishop(from, position.all);
+    else if(type == ROOK) targets = Attacks::rook(from, position.all);
+    else if(type == QUEEN) targets = Attacks::bishop(from, position.all) | Attacks::rook(from, position.all);
+    else if(type == PAWN) {
+      int front_direction = (us == WHITE ? -8 : 8);
+      int initial_row = (us == WHITE ? 6 : 1);
+
+      targets = Attacks::PAWN[us][from] & enemy;
+      // Single move
+      if(empty & squareBB(from + front_direction)) {
+        targets |= squareBB(from + front_direction);
+        // Two moves
+        if(squareY(from) == initial_row && (empty & squareBB(from + 2 * front_direction))) {
+          targets |= squareBB(from + 2 * front_direction);
         }
       }
     }
-    if(setup[i].first[1] == 'k') {
-      // King moves
-      int dl1[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-      int dc1[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-      for(int j=0;j<8;j++) {
-        pii new_pos = setup[i].second;
-        new_pos.first += dl1[j];
-        new_pos.second += dc1[j];
-
-        if(isValidMove(current_pos, new_pos)) {
-          nextMoves.push_back({current_pos, new_pos});
-        }
-      }
-      // White Castling: left side
-      if(isWhiteTurn() && gs.isCastlingPreserved(0) && getPositionInfo(0, 7) == "wr"
-        && getPositionInfo(1, 7) == "" && getPositionInfo(2, 7) == "" && getPositionInfo(3, 7) == "" && !isOnCheck()) {
+    targets &= ~own & check_mask;
+    if(pinned & squareBB(from)) targets &= Attacks::LINE[king_sq][from];
 
-        if(isValidMove({4, 7}, {3, 7}) && isValidMove({4, 7}, {2, 7})) {
-          nextMoves.push_back({{4, 7}, {2, 7}});
-        } 
-      }
-      // Black Castling: left side
-      if(!isWhiteTurn() && gs.isCastlingPreserved(2) && getPositionInfo(0, 0) == "br"
-        && getPositionInfo(1, 0) == "" && getPositionInfo(2, 0) == "" && getPositionInfo(3, 0) == "" &&  !isOnCheck()) {
+    while(targets) {
+      if(type == PAWN) addPawnMove(from, popLsb(targets));
+      else addMove(from, popLsb(targets));
+    }
+  }
 
-        if(isValidMove({4, 0}, {3, 0}) && isValidMove({4, 0}, {2, 0})) {
-          nextMoves.push_back({{4, 0}, {2, 0}});
-        } 
-      }
-      if(isWhiteTurn() && gs.isCastlingPreserved(1) && getPositionInfo(7, 7) == "wr"
-        && getPositionInfo(5, 7) == "" && getPositionInfo(6, 7) == "" && !isOnCheck()) {
+  // En passant: the two pawns leave the same row at once, so it is checked on the board
+  if(gs.enPassant.first != -1) {
+    int victim = makeSquare(gs.enPassant.first, gs.enPassant.second);
+    int target = victim + (us == WHITE ? -8 : 8);
+    Bitboard attackers = Attacks::PAWN[them][target] & position.byType(us, PAWN);
 
-        if(isValidMove({4, 7}, {5, 7}) && isValidMove({4, 7}, {6, 7})) {
-          nextMoves.push_back({{4, 7}, {6, 7}});
-        }
-      }
-      // Black Castling: right side
-      if(!isWhiteTurn() && gs.isCastlingPreserved(3) && getPositionInfo(7, 0) == "br"
-        && getPositionInfo(5, 0) == "" && getPositionInfo(6, 0) == "" && !isOnCheck()) {
+    while(attackers) {
+      int from = popLsb(attackers);
+      Piece attacker = position.at(from);
+      Piece deffensor = position.at(victim);
 
-        if(isValidMove({4, 0}, {5, 0}) && isValidMove({4, 0}, {6, 0})) {
-          nextMoves.push_back({{4, 0}, {6, 0}});
-        }
-      }
-    }
-    if(setup[i].first[1] == 'r' || setup[i].first[1] == 'q') {
-      // Rook & Queen moves
-      int dl2[] = {-1, 0, 1, 0};
-      int dc2[] = {0, -1, 0, 1};
-      for(int j=0;j<4;j++) {
-        pii new_pos = current_pos;
-        for(int k=0;k<8;k++) {
-          new_pos.first += dl2[j];
-          new_pos.second += dc2[j];
-
-          if(isValidMove(current_pos, new_pos)) {
-            nextMoves.push_back({current_pos, new_pos});
-          }
-
-          if(getPositionInfo(new_pos.first, new_pos.second) != "") break;
-        }
-      }
-    }
-    if(setup[i].first[1] == 'b' || setup[i].first[1] == 'q') {
-      // Bishop & Queen moves
-      int dl3[] = {-1, -1, 1, 1};
-      int dc3[] = {-1, 1, 1, -1};
-      for(int j=0;j<4;j++) {
-        pii new_pos = current_pos;
-        for(int k=0;k<8;k++) {
-          new_pos.first += dl3[j];
-          new_pos.second += dc3[j];
-
-          if(isValidMove(current_pos, new_pos)) {
-            nextMoves.push_back({current_pos, new_pos});
-          }
-
-          if(getPositionInfo(new_pos.first, new_pos.second) != "") break;
-        }
-      }
-    }
-    if(setup[i].first[1] == 'p') {
-      int front_direction = (isWhiteTurn() ? -1 : 1);
-      int initial_row = (7 + front_direction) % 7;
-
-      // Left taking
-      if(isValidMove(current_pos, {current_pos.first - 1, current_pos.second + front_direction})) {
-        std::string info = getPositionInfo(current_pos.first - 1, current_pos.second + front_direction);
-        if(info != "" && info[0] != setup[i].first[0]) {
-          nextMoves.push_back({current_pos, {current_pos.first - 1, current_pos.second + front_direction}});
-        }
-      }
-      // Right taking
-      if(isValidMove(current_pos, {current_pos.first + 1, current_pos.second + front_direction})) {
-        std::string info = getPositionInfo(current_pos.first + 1, current_pos.second + front_direction);
-        if(info != "" && info[0] != setup[i].first[0]) {
-          nextMoves.push_back({current_pos, {current_pos.first + 1, current_pos.second + front_direction}});
-        }
-      }
-      // En passant
-      if(gs.enPassant == std::make_pair(current_pos.first - 1, current_pos.second)
-        || gs.enPassant == std::make_pair(current_pos.first + 1, current_pos.second)) {
+      position.remove(from);
+      position.remove(victim);
+      position.put(target, attacker);
 
-        std::string attacker = board[current_pos.first][current_pos.second];
-        std::string deffensor = board[gs.enPassant.first][gs.enPassant.second];
+      if(!isOnCheck()) addMove(from, target, MOVE_EN_PASSANT);
 
-        board[current_pos.first][current_pos.second] = "";
-        board[gs.enPassant.first][gs.enPassant.second] = "";
-        board[gs.enPassant.first][gs.enPassant.second + front_direction] = attacker;
+      position.remove(target);
+      position.put(victim, deffensor);
+      position.put(from, attacker);
+    }
+  }
 
-        if(!isOnCheck()) {
-          nextMoves.push_back({current_pos, {gs.enPassant.first, gs.enPassant.second + front_direction}});
-        }
+  // Castling
+  int row = (us == WHITE ? 7 : 0);
+  Piece rook = makePiece(us, ROOK);
+  if(checkers == 0 && king_sq == makeSquare(4, row)) {
+    // Left side
+    if(gs.isCastlingPreserved(2 * us) && position.at(makeSquare(0, row)) == rook
+      && (Attacks::BETWEEN[king_sq][makeSquare(0, row)] & position.all) == 0
+      && !position.isAttacked(makeSquare(3, row), them) && !position.isAttacked(makeSquare(2, row), them)) {
 
-        board[current_pos.first][current_pos.second] = attacker;
-        board[gs.enPassant.first][gs.enPassant.second] = deffensor;
-        board[gs.enPassant.first][gs.enPassant.second + front_direction] = "";
-      }
-      // Two moves
-      if(current_pos.second == initial_row) {
-        if(board[current_pos.first][current_pos.second + front_direction] == ""
-          && board[current_pos.first][current_pos.second + 2 * front_direction] == "") {
-
-          if(isValidMove(current_pos, {current_pos.first, current_pos.second + 2 * front_direction})) {
-            nextMoves.push_back({current_pos, {current_pos.first, current_pos.second + 2 * front_direction}});
-          }
-        }
-      }
-      // Single move
-      if(getPositionInfo(current_pos.first, current_pos.second + front_direction) == "") {
-        if(isValidMove(current_pos, {current_pos.first, current_pos.second + front_direction})) {
-          nextMoves.push_back({current_pos, {current_pos.first, current_pos.second + front_direction}});
-        }
-      }
+      addMove(king_sq, makeSquare(2, row), MOVE_CASTLING);
+    }
+    // Right side
+    if(gs.isCastlingPreserved(2 * us + 1) && position.at(makeSquare(7, row)) == rook
+      && (Attacks::BETWEEN[king_sq][makeSquare(7, row)] & position.all) == 0
+      && !position.isAttacked(makeSquare(5, row), them) && !position.isAttacked(makeSquare(6, row), them)) {
+
+      addMove(king_sq, makeSquare(6, row), MOVE_CASTLING);
     }
   }
-  t = (std::clock() - t);
-  elapsed_sec["genNextMoves"] += ((double)t/CLOCKS_PER_SEC) * 1000.0;
-  called_counter["genNextMoves"]++;
 }
 
-double Game::evaluatePiece(std::string piece) {
-  if(piece == "") return 0.0;
-  int mult = (piece[0] == 'w' ? 1.0 : -1.0);
+double Game::evaluatePiece(Piece piece) const {
+  if(piece == NO_PIECE) return 0.0;
+  int mult = (pieceColor(piece) == WHITE ? 1.0 : -1.0);
+  return mult * Evaluation::VALUE[pieceType(piece)] / 100.0;
+}
 
-  double value = 0.0;
+void Game::addPiece(GameState &gs, Piece piece, int sq, int sign) const {
+  // sign is 1 when the piece lands on sq, -1 when it leaves
+  if(piece == NO_PIECE) return;
+  gs.material += sign * (pieceColor(piece) == WHITE ? 1 : -1) * Evaluation::VALUE[pieceType(piece)];
+  gs.psq_mg += sign * Evaluation::MG[piece][sq];
+  gs.psq_eg += sign * Evaluation::EG[piece][sq];
+}
 
-  if(piece[1] == 'r') value = 5.0;
-  else if(piece[1] == 'n') value = 3.0;
-  else if(piece[1] == 'b') value = 3.0;
-  else if(piece[1] == 'q') value = 9.0;
-  else if(piece[1] == 'p') value = 1.0;
+double Game::evaluateState(const GameState &gs, bool white_turn) const {
+  if(network) {
+    // The last accumulator is the position of gs
+    int score = network->evaluate(accumulators.back(), white_turn ? WHITE : BLACK);
+    return (white_turn ? score : -score) / 100.0;
+  }
 
-  return mult * value;
+  // Phase from the pieces left, see counter_pos: rooks in slot 0, knights 1, bishops 2-3, queens 4
+  const std::array<int, 12> &c = gs.pieces_counter;
+  int phase = 0;
+  for(int side=0;side<12;side+=6) phase += 2*c[side] + c[side + 1] + c[side + 2] + c[side + 3] + 4*c[side + 4];
+  return (gs.material + Evaluation::taper(gs.psq_mg, gs.psq_eg, phase)) / 100.0;
 }
 
-void Game::executeMove(std::vector<std::pair<pii, std::string>> &move, GameState &gs) {
-  std::clock_t t = std::clock();
-  std::vector<std::pair<pii, std::string>> rollback;
-  double score = 0.0;
+void Game::executeMove(const SquareChanges &move, GameState &gs) {
+  PROFILE_SCOPE("executeMove");
+  SquareChanges rollback;
+  if(network) accumulators.push_back(accumulators.back());
 
-  for(auto &m: move) {
-    std::string curr_piece = board[m.first.first][m.first.second];
-    rollback.push_back({m.first, curr_piece});
-    board[m.first.first][m.first.second] = m.second;
+  for(int i=0;i<move.count;i++) {
+    int sq = move.square[i];
+    Piece curr_piece = position.at(sq);
+    rollback.add(sq, curr_piece);
+    position.set(sq, move.piece[i]);
 
-    score -= evaluatePiece(curr_piece);
-    score += evaluatePiece(m.second);
+    gs.key ^= Zobrist::piece(curr_piece, sq) ^ Zobrist::piece(move.piece[i], sq);
 
-    std::vector<std::pair<std::string, int>> tmp;
-    tmp.push_back({curr_piece, -1});
-    tmp.push_back({m.second, 1});
-
-    for(auto &t: tmp) {
-      int id = piece_pos[t.first];
-      if(id == 2 || id == 8) {
-        id += (m.first.first%2 + m.first.second%2)%2;
-      }
-      if(id == -1) continue;
+    addPiece(gs, curr_piece, sq, -1);
+    addPiece(gs, move.piece[i], sq, 1);
+    if(network) network->update(accumulators.back(), sq, curr_piece, move.piece[i]);
 
-      gs.pieces_counter[id] += t.second;
-    }
+    int removed = counterIndex(curr_piece, sq);
+    int added = counterIndex(move.piece[i], sq);
+    if(removed != -1) gs.pieces_counter[removed]--;
+    if(added != -1) gs.pieces_counter[added]++;
   }
 
   moves.push_back(rollback);
-  gs.gameScore += score;
-
-  t = (std::clock() - t);
-  elapsed_sec["executeMove"] += ((double)t/CLOCKS_PER_SEC) * 1000.0;
-  called_counter["executeMove"]++;
+  gs.scored = !network; // The network runs in scoreState, for the positions that need a score
+  if(gs.scored) gs.gameScore = evaluateState(gs, isWhiteTurn());
 }
 
 void Game::undoAction() {
   gameState.pop_back();
+  if(network) accumulators.pop_back();
 
-  hashedBoardCounter[getBoardHash()]--;
-
-  auto &undo_move = moves.back();
-  for(auto &m: undo_move) {
-    board[m.first.first][m.first.second] = m.second;
+  const SquareChanges &undo_move = moves.back();
+  for(int i=0;i<undo_move.count;i++) {
+    position.set(undo_move.square[i], undo_move.piece[i]);
   }
   moves.pop_back();
-
-  genNextMoves(gameState.back());
 }
 
-void Game::doAction(pii current_pos, pii new_pos, int choose) {
-  std::clock_t t = std::clock();
-  assert(isAvailable(current_pos, new_pos));
+void Game::doAction(Move move) {
+  PROFILE_SCOPE("doAction");
+  assert(isAvailable(move));
 
   const GameState curr_gs = getState();
   GameState new_gs = curr_gs;
   new_gs.enPassant = {-1, -1};
 
-  std::string piece = board[current_pos.first][current_pos.second];
-  std::vector<std::pair<pii, std::string>> current_move;
+  int from = moveFrom(move);
+  int to = moveTo(move);
+  Piece piece = position.at(from);
+  int type = pieceType(piece);
+  int us = pieceColor(piece);
+  SquareChanges current_move;
+
+  // Side to move, castling rights and en passant are re-hashed once the move is done
+  new_gs.key ^= castlingKey(curr_gs) ^ enPassantKey(curr_gs) ^ Zobrist::turn();
+  if(type == PAWN || position.at(to) != NO_PIECE) new_gs.reversible_moves = 0;
+  else new_gs.reversible_moves++;
 
-  if(piece[1] == 'p' && board[new_pos.first][new_pos.second] == "" && current_pos.first != new_pos.first) {
+  if(moveFlag(move) == MOVE_EN_PASSANT) {
     // Action: En passant
-    current_move.push_back({{current_pos.first, current_pos.second}, ""});
-    current_move.push_back({{new_pos.first, new_pos.second}, piece});
-    current_move.push_back({{curr_gs.enPassant.first, curr_gs.enPassant.second}, ""});
+    current_move.add(from, NO_PIECE);
+    current_move.add(to, piece);
+    current_move.add(makeSquare(curr_gs.enPassant.first, curr_gs.enPassant.second), NO_PIECE);
 
-  } else if(piece[1] == 'k' && int(std::abs(current_pos.first - new_pos.first)) == 2) {
+  } else if(moveFlag(move) == MOVE_CASTLING) {
     // Action: Castling
-    int row = current_pos.second;
-    if(new_pos.first == 2) {
-      std::string rook = board[0][row];
+    int row = squareY(from);
+    if(squareX(to) == 2) {
+      Piece rook = getPositionInfo(0, row);
 
-      current_move.push_back({{0, row}, ""});
-      current_move.push_back({{2, row}, piece});
-      current_move.push_back({{3, row}, rook});
-      current_move.push_back({{4, row}, ""});
+      current_move.add(makeSquare(0, row), NO_PIECE);
+      current_move.add(makeSquare(2, row), piece);
+      current_move.add(makeSquare(3, row), rook);
+      current_move.add(makeSquare(4, row), NO_PIECE);
 
     } else {
-      std::string rook = board[7][row];
+      Piece rook = getPositionInfo(7, row);
 
-      current_move.push_back({{7, row}, ""});
-      current_move.push_back({{6, row}, piece});
-      current_move.push_back({{5, row}, rook});
-      current_move.push_back({{4, row}, ""});
+      current_move.add(makeSquare(7, row), NO_PIECE);
+      current_move.add(makeSquare(6, row), piece);
+      current_move.add(makeSquare(5, row), rook);
+      current_move.add(makeSquare(4, row), NO_PIECE);
 
     }
 
-    if(isWhiteTurn()) {
-      new_gs.touch(0);
-      new_gs.touch(1);
-    } else {
-      new_gs.touch(2);
-      new_gs.touch(3);
-    }
-  } else if(piece[1] == 'p' && int(std::abs(current_pos.second - new_pos.second)) == 2) {
+    new_gs.touch(2 * us);
+    new_gs.touch(2 * us + 1);
+  } else if(type == PAWN && int(std::abs(squareY(from) - squareY(to))) == 2) {
     // Action: Two moves
-    new_gs.enPassant = new_pos;
+    new_gs.enPassant = {squareX(to), squareY(to)};
 
-    current_move.push_back({{current_pos.first, current_pos.second}, ""});
-    current_move.push_back({{new_pos.first, new_pos.second}, piece});
+    current_move.add(from, NO_PIECE);
+    current_move.add(to, piece);
 
-  } else if(piece[1] == 'p' && (new_pos.second == 0 || new_pos.second == 7)) {
+  } else if(moveFlag(move) == MOVE_PROMOTION) {
     // Action: Promotion
-    assert(choose != -1);
-    std::string promotedPiece = (isWhiteTurn() ? "w" : "b");
-    if(choose == 0) promotedPiece += "q";
-    else if(choose == 1) promotedPiece += "r";
-    else if(choose == 2) promotedPiece += "n";
-    else if(choose == 3) promotedPiece += "b";
+    Piece promotedPiece = makePiece(us, promotionType(move));
 
-    current_move.push_back({{current_pos.first, current_pos.second}, ""});
-    current_move.push_back({{new_pos.first, new_pos.second}, promotedPiece});
+    current_move.add(from, NO_PIECE);
+    current_move.add(to, promotedPiece);
 
   } else {
     // Any other move
-    current_move.push_back({{current_pos.first, current_pos.second}, ""});
-    current_move.push_back({{new_pos.first, new_pos.second}, piece});
+    current_move.add(from, NO_PIECE);
+    current_move.add(to, piece);
 
   }
   executeMove(current_move, new_gs);
-  new_gs.repetition = storeHashedBoard() == 3;
-
-  if(piece == "wk") new_gs.touch(0), new_gs.touch(1);
-  if(piece == "bk") new_gs.touch(2), new_gs.touch(3);
-  if(piece == "wr" && current_pos.first == 0) new_gs.touch(0);
-  if(piece == "wr" && current_pos.first == 7) new_gs.touch(1);
-  if(piece == "br" && current_pos.first == 0) new_gs.touch(2);
-  if(piece == "br" && current_pos.first == 7) new_gs.touch(3);
 
-  genNextMoves(new_gs);
+  // Moving the king or a rook, or capturing a rook at home, loses castling rights
+  new_gs.castlingPreserved |= castlingTouch(from) | castlingTouch(to);
+  new_gs.key ^= castlingKey(new_gs) ^ enPassantKey(new_gs);
+  new_gs.repetition = isRepetition(new_gs);
 
-  if(isWhiteTurn()) new_gs.moves_white = nextMoves.size();
-  else new_gs.moves_black = nextMoves.size();
+  // The move list of the new position is built the first time it is needed
+  int ply = moves.size();
+  if(nextMoves.size() <= ply) {
+    nextMoves.resize(ply + 1);
+    nextMovesReady.resize(ply + 1);
+  }
+  nextMovesReady[ply] = false;
 
+  new_gs.gameStatus = "unknown";
   if(drawConditions(new_gs)) {
     new_gs.gameStatus = "draw";
     new_gs.gameScore = 0.0;
+    new_gs.scored = true;
   }
-  if(nextMoves.size() == 0 && isOnCheck()) {
-    new_gs.gameStatus = "checkmate";
-    if(isWhiteTurn()) new_gs.gameScore = -1000;
-    else new_gs.gameScore = 1000;
+
+  addState(new_gs);
+}
+
+void Game::doNullMove() {
+  // Only the side to move changes; repetitions are not looked for across it
+  assert(!isOnCheck());
+  const GameState curr_gs = getState();
+  GameState new_gs = curr_gs;
+  new_gs.enPassant = {-1, -1};
+  new_gs.key ^= enPassantKey(curr_gs) ^ Zobrist::turn();
+  new_gs.reversible_moves = 0;
+  new_gs.repetition = false;
+  moves.push_back(SquareChanges());
+  if(network) accumulators.push_back(accumulators.back());
+  new_gs.scored = !network; // The network scores the side to move, it has to run again
+
+  int ply = moves.size();
+  if(nextMoves.size() <= ply) {
+    nextMoves.resize(ply + 1);
+    nextMovesReady.resize(ply + 1);
   }
+  nextMovesReady[ply] = false;
 
+  new_gs.gameStatus = "unknown";
   addState(new_gs);
+}
 
-  t = (std::clock() - t);
-  elapsed_sec["doAction"] += ((double)t/CLOCKS_PER_SEC) * 1000.0;
-  called_counter["doAction"]++;
+void Game::setNetwork(std::shared_ptr<const Nnue::Network> network) {
+  /*
+    Every ply is scored again with the new evaluation: the board is taken
+    back to the first position and the moves are replayed on it. Decided
+    positions (mate, draws) keep their score.
+  */
+  this->network = network;
+  accumulators.clear();
+
+  int plies = moves.size();
+  std::vector<SquareChanges> redo(plies);
+  for(int i=plies - 1;i>=0;i--) {
+    for(int j=0;j<moves[i].count;j++) {
+      int sq = moves[i].square[j];
+      redo[i].add(sq, position.at(sq));
+      position.set(sq, moves[i].piece[j]);
+    }
+  }
+
+  for(int i=0;i<=plies;i++) {
+    if(network && i == 0) {
+      accumulators.emplace_back();
+      network->refresh(position, accumulators.back());
+    } else if(network) {
+      accumulators.push_back(accumulators.back());
+    }
+    for(int j=0;i>0 && j<redo[i - 1].count;j++) {
+      int sq = redo[i - 1].square[j];
+      if(network) network->update(accumulators.back(), sq, position.at(sq), redo[i - 1].piece[j]);
+      position.set(sq, redo[i - 1].piece[j]);
+    }
+
+    GameState &gs = gameState[i];
+    if(gs.gameStatus == "draw" || gs.gameStatus == "checkmate") continue;
+    gs.scored = !network;
+    if(gs.scored) gs.gameScore = evaluateState(gs, (i + first_ply) % 2 == 0);
+  }
 }
 
-bool Game::hasMoveFor(pii pos) {
-  for(int i=0;i<nextMoves.size();i++) {
-    if(nextMoves[i].first == pos) return true;
+bool Game::hasPieces(bool white) const {
+  // pieces_counter keeps each color's pawns in slot 5, see counter_pos
+  const std::array<int, 12> &counter = gameState.back().pieces_counter;
+  int offset = (white ? 0 : 6);
+  for(int id=0;id<5;id++) {
+    if(counter[offset + id] > 0) return true;
   }
   return false;
 }
 
-bool Game::isAvailable(pii curr_pos, pii new_pos) {
-  std::clock_t t = std::clock();
-  for(int i=0;i<nextMoves.size();i++) {
-    if(nextMoves[i].first == curr_pos && nextMoves[i].second == new_pos) return true;
+bool Game::hasMoveFor(pii pos) {
+  const auto &next_moves = getNextMoves();
+  int sq = makeSquare(pos.first, pos.second);
+  for(Move m: next_moves) {
+    if(moveFrom(m) == sq) return true;
   }
-  t = (std::clock() - t);
-  elapsed_sec["doAction"] += ((double)t/CLOCKS_PER_SEC) * 1000.0;
-  called_counter["doAction"]++;
   return false;
 }
 
-bool Game::isPawnPromotion(pii curr_pos, pii new_pos) {
-  if(!isAvailable(curr_pos, new_pos)) return false;
+bool Game::isAvailable(pii curr_pos, pii new_pos) {
+  return getMove(curr_pos, new_pos) != MOVE_NONE;
+}
+
+bool Game::isAvailable(Move move) {
+  PROFILE_SCOPE("isAvailable");
+  const auto &next_moves = getNextMoves();
+  bool found = std::find(next_moves.begin(), next_moves.end(), move) != next_moves.end();
+  return found;
+}
 
-  int promotion_y = (isWhiteTurn() ? 0 : 7);
+Move Game::getMove(pii curr_pos, pii new_pos, int choose) {
+  // The legal move between two cells; promotions pick the piece with choose (any if -1)
+  int from = makeSquare(curr_pos.first, curr_pos.second);
+  int to = makeSquare(new_pos.first, new_pos.second);
+  for(Move m: getNextMoves()) {
+    if(moveFrom(m) != from || moveTo(m) != to) continue;
+    if(choose == -1 || moveChoose(m) == choose) return m;
+  }
+  return MOVE_NONE;
+}
 
-  return (board[curr_pos.first][curr_pos.second][1] == 'p' && new_pos.second == promotion_y);
+Move Game::getMove(const std::string &notation) {
+  // The legal move written in coordinate notation (e2e4, e7e8q), MOVE_NONE if there is none
+  for(Move m: getNextMoves()) {
+    if(moveToString(m) == notation) return m;
+  }
+  return MOVE_NONE;
+}
+
+bool Game::isPawnPromotion(pii curr_pos, pii new_pos) {
+  return moveFlag(getMove(curr_pos, new_pos)) == MOVE_PROMOTION;
 }
 
 bool Game::drawConditions(const GameState &gs) const {
   // Repetition
   if(gs.repetition) return true;
 
-  // Stalemate
-  if(nextMoves.size() == 0) return true;
   // Insufficient mating material
   bool isInsufficient = true;
   int total_pieces = 0;
@@ -647,49 +796,66 @@ int Game::getTotalMoves() const {
   return moves.size();
 }
 
-std::vector<std::pair<pii, pii>> Game::getAllMoves() {
-  return nextMoves;
+const std::vector<Move> &Game::getAllMoves() {
+  // The list is kept until undoAction leaves this ply; deeper doAction calls do not touch it
+  return getNextMoves();
 }
 
-double Game::getScore() const {
+void Game::scoreState() {
+  GameState &gs = gameState.back();
+  if(gs.scored) return;
+  gs.gameScore = evaluateState(gs, isWhiteTurn());
+  gs.scored = true;
+}
 
+double Game::getScore() {
+  resolveStatus();
+  scoreState();
   return getState().gameScore;
 }
 
-// Performance
-void Game::performance() {
-  std::cerr << "----------------------\n";
-  std::cerr << "PERF ANALYSIS\n\n";
-  for(const auto &data: elapsed_sec) {
-    const std::string &f = data.first;
-    int cnt = called_counter.at(f);
-    double ms = (data.second / cnt);
-    std::cerr << std::fixed << std::setprecision(3);
-
-    std::cerr << "Function: " << f << "\n";
-    std::cerr << "* Total time:     " << (data.second / (1000.0)) << "s\n";
-    std::cerr << "* function calls: " << cnt << "\n";
-    std::cerr << "* average time:   " << ms << "ms\n\n"; 
+double Game::getStaticScore() {
+  // Without a check there is no mate to find, so the move list is left unbuilt.
+  // A stalemate is therefore only seen once the position's moves are generated.
+  if(getState().gameStatus == "unknown" && !isOnCheck()) {
+    scoreState();
+    return getState().gameScore;
   }
+  return getScore();
+}
+
+uint64_t Game::getKey() const {
+  return getState().key;
+}
 
-  elapsed_sec.clear();
-  called_counter.clear();
+// Performance
+void Game::performance() {
+  // Counters are shared by every Game, see Profiler.hpp
+  Profiler::report(std::cerr);
+  Profiler::reset();
 }
 
 double Game::getCellScore(int x, int y) const {
-  std::string info = getPositionInfo(x, y);
-  assert(info != "out");
+  return evaluatePiece(getPositionInfo(x, y));
+}
 
-  if(info == "") return 0.0;
-  double sc = 0.0;
-  if(info[1] == 'p') sc = 1.0;
-  else if(info[1] == 'r') sc = 5.0;
-  else if(info[1] == 'n') sc = 3.0;
-  else if(info[1] == 'b') sc = 3.0;
-  else if(info[1] == 'q') sc = 9.0;
-  else if(info[1] == 'k') sc = 0.0;
+Piece Game::getPiece(int sq) const {
+  return position.at(sq);
+}
 
-  if(info[0] == 'b') sc *= -1.0;
+const Position &Game::getPosition() const {
+  return position;
+}
+
+int Game::getPieceCount() const {
+  const GameState &gs = gameState.back();
+  int count = 2;
+  for(int c: gs.pieces_counter) count += c;
+  return count;
+}
 
-  return sc;
+bool Game::hasSpecialRights() const {
+  // Exactly what the key hashes beyond the pieces and the turn
+  const GameState &gs = gameState.back();
+  return castlingKey(gs) != 0 || enPassantKey(gs) != 0;
 }
@@ -0,0 +1,59 @@
+#include <MoveOrdering.hpp>
+#include <cstring>
+
+MoveOrdering::MoveOrdering() {
+  clear();
+}
+
+void MoveOrdering::clear() {
+  for(int ply=0;ply<MAX_PLY;ply++) killers[ply][0] = killers[ply][1] = MOVE_NONE;
+  memset(history, 0, sizeof(history));
+}
+
+bool MoveOrdering::isQuiet(const Game &game, Move move) const {
+  if(moveFlag(move) == MOVE_PROMOTION || moveFlag(move) == MOVE_EN_PASSANT) return false;
+  return game.getPiece(moveTo(move)) == NO_PIECE;
+}
+
+int MoveOrdering::gain(const Game &game, Move move) const {
+  const int values[6] = {1, 3, 3, 5, 9, 0};
+  int gain = 0;
+  if(moveFlag(move) == MOVE_EN_PASSANT) gain += values[PAWN];
+  else if(game.getPiece(moveTo(move)) != NO_PIECE) gain += values[pieceType(game.getPiece(moveTo(move)))];
+  if(moveFlag(move) == MOVE_PROMOTION) gain += values[promotionType(move)] - values[PAWN];
+  return gain;
+}
+
+int MoveOrdering::key(const Game &game, Move move, Move hash_move, int ply) const {
+  if(move == hash_move) return HASH_KEY;
+
+  if(!isQuiet(game, move)) {
+    int attacker = pieceType(game.getPiece(moveFrom(move)));
+    return CAPTURE_KEY + gain(game, move) * 8 + (KING - attacker);
+  }
+
+  if(ply < MAX_PLY) {
+    if(move == killers[ply][0]) return KILLER_KEY + 1;
+    if(move == killers[ply][1]) return KILLER_KEY;
+  }
+
+  int side = (game.isWhiteTurn() ? WHITE : BLACK);
+  return history[side][moveFrom(move)][moveTo(move)];
+}
+
+void MoveOrdering::cutoff(const Game &game, Move move, int deep, int ply) {
+  if(ply < MAX_PLY && killers[ply][0] != move) {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = move;
+  }
+
+  int side = (game.isWhiteTurn() ? WHITE : BLACK);
+  int &h = history[side][moveFrom(move)][moveTo(move)];
+  h += deep * deep;
+  if(h >= HISTORY_MAX) {
+    // Age the whole side so the relative order survives
+    for(int from=0;from<64;from++) {
+      for(int to=0;to<64;to++) history[side][from][to] /= 2;
+    }
+  }
+}
@@ -0,0 +1,141 @@
+#include <Nnue.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+  int32_t dot(const uint8_t *input, const int8_t *weights, int n) {
+    // n a multiple of 32; inputs stay in [0, 127] so maddubs never saturates
+#if defined(__AVX2__)
+    __m256i sum = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    for(int i=0;i<n;i+=32) {
+      __m256i in = _mm256_loadu_si256((const __m256i *)(input + i));
+      __m256i w = _mm256_loadu_si256((const __m256i *)(weights + i));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSE2__)
+    // No maddubs before SSSE3: both sides are widened to int16 first
+    __m128i sum = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for(int i=0;i<n;i+=16) {
+      __m128i in = _mm_loadu_si128((const __m128i *)(input + i));
+      __m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+      __m128i sign = _mm_cmpgt_epi8(zero, w);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(in, zero), _mm_unpacklo_epi8(w, sign)));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(in, zero), _mm_unpackhi_epi8(w, sign)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for(int i=0;i<n;i++) sum += input[i] * weights[i];
+    return sum;
+#endif
+  }
+
+  template<typename T>
+  bool readArray(std::ifstream &in, std::vector<T> &values, size_t count) {
+    values.resize(count);
+    in.read((char *)values.data(), count * sizeof(T));
+    return (bool)in;
+  }
+}
+
+namespace Nnue {
+  bool Network::load(const std::string &path, std::string &error) {
+    // On failure the network is left unusable
+    std::ifstream in(path, std::ios::binary);
+    if(!in) {
+      error = "cannot open " + path;
+      return false;
+    }
+
+    char magic[4];
+    uint32_t header[3];
+    in.read(magic, sizeof(magic));
+    in.read((char *)header, sizeof(header));
+    if(!in || memcmp(magic, "NNUE", 4)) {
+      error = path + " is not a network file";
+      return false;
+    }
+    if(header[0] != VERSION || header[1] != HIDDEN || header[2] != L1) {
+      error = path + ": version " + std::to_string(header[0]) + ", " + std::to_string(header[1]) + " x "
+        + std::to_string(header[2]) + " (expected version " + std::to_string(VERSION) + ", "
+        + std::to_string(HIDDEN) + " x " + std::to_string(L1) + ")";
+      return false;
+    }
+
+    bool ok = readArray(in, ft_weights, INPUTS * HIDDEN) && readArray(in, ft_bias, HIDDEN)
+      && readArray(in, l1_weights, L1 * 2 * HIDDEN) && readArray(in, l1_bias, L1)
+      && readArray(in, out_weights, L1);
+    in.read((char *)&out_bias, sizeof(out_bias));
+    if(!ok || !in) {
+      error = path + " is truncated";
+      return false;
+    }
+    if(in.peek() != std::ifstream::traits_type::eof()) {
+      error = path + " is longer than its header says";
+      return false;
+    }
+    return true;
+  }
+
+  void Network::addFeature(Accumulator &acc, Piece p, int sq, int sign) const {
+    for(int side=WHITE;side<=BLACK;side++) {
+      const int16_t *row = &ft_weights[feature(side, p, sq) * HIDDEN];
+      int16_t *values = acc.values[side].data();
+      if(sign > 0) for(int i=0;i<HIDDEN;i++) values[i] += row[i];
+      else for(int i=0;i<HIDDEN;i++) values[i] -= row[i];
+    }
+  }
+
+  void Network::refresh(const Position &position, Accumulator &acc) const {
+    for(int side=WHITE;side<=BLACK;side++) std::copy(ft_bias.begin(), ft_bias.end(), acc.values[side].begin());
+    for(int sq=0;sq<64;sq++) {
+      if(position.at(sq) != NO_PIECE) addFeature(acc, position.at(sq), sq, 1);
+    }
+  }
+
+  void Network::update(Accumulator &acc, int sq, Piece removed, Piece added) const {
+    if(removed != NO_PIECE) addFeature(acc, removed, sq, -1);
+    if(added != NO_PIECE) addFeature(acc, added, sq, 1);
+  }
+
+  int Network::evaluate(const Accumulator &acc, int us) const {
+    alignas(32) uint8_t input[2 * HIDDEN];
+    for(int half=0;half<2;half++) {
+      const int16_t *values = acc.values[half == 0 ? us : 1 - us].data();
+      for(int i=0;i<HIDDEN;i++) input[half * HIDDEN + i] = std::clamp<int>(values[i], 0, 127);
+    }
+
+    alignas(32) uint8_t hidden[L1];
+    for(int j=0;j<L1;j++) {
+      int32_t sum = l1_bias[j] + dot(input, &l1_weights[j * 2 * HIDDEN], 2 * HIDDEN);
+      hidden[j] = std::clamp(sum >> WEIGHT_SHIFT, 0, 127);
+    }
+
+    return (out_bias + dot(hidden, out_weights.data(), L1)) / OUTPUT_SCALE;
+  }
+
+  const char *Network::kernel() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+  }
+}
@@ -0,0 +1,67 @@
+#include <NodeArena.hpp>
+#include <algorithm>
+
+NodeArena::NodeArena(int size_mb) {
+  setBudget(size_mb);
+}
+
+uint64_t NodeArena::bytesPerNode() {
+  return sizeof(Move) + sizeof(double) + sizeof(NodeIndex) + sizeof(uint8_t);
+}
+
+void NodeArena::setBudget(int size_mb) {
+  // Never below a few full move lists, a fresh root must always fit its children
+  max_nodes = std::max<uint64_t>(((uint64_t)std::max(size_mb, 1) << 20) / bytesPerNode(), 4096);
+  max_nodes = std::min<uint64_t>(max_nodes, NO_NODE);
+
+  // Address space only: pages are touched as rows are used, and rows never move
+  if(moves.capacity() > max_nodes) {
+    std::vector<Move>().swap(moves);
+    std::vector<double>().swap(orders);
+    std::vector<NodeIndex>().swap(children);
+    std::vector<uint8_t>().swap(counts);
+  }
+  moves.reserve(max_nodes);
+  orders.reserve(max_nodes);
+  children.reserve(max_nodes);
+  counts.reserve(max_nodes);
+  reset();
+}
+
+void NodeArena::reset() {
+  // Capacity is kept, a new tree reuses the memory of the old one
+  moves.clear();
+  orders.clear();
+  children.clear();
+  counts.clear();
+  peak = 0;
+  grow(1);
+  moves[0] = MOVE_NONE;
+  orders[0] = 0.0;
+  children[0] = NO_NODE;
+  counts[0] = 0;
+}
+
+void NodeArena::grow(uint64_t size) {
+  moves.resize(size);
+  orders.resize(size);
+  children.resize(size);
+  counts.resize(size);
+  peak = std::max(peak, size);
+}
+
+bool NodeArena::expand(NodeIndex node, const std::vector<Move> &child_moves) {
+  uint64_t first = moves.size();
+  if(first + child_moves.size() > max_nodes) return false;
+
+  grow(first + child_moves.size());
+  for(int i=0;i<child_moves.size();i++) {
+    moves[first + i] = child_moves[i];
+    orders[first + i] = 0.0;
+    children[first + i] = NO_NODE;
+    counts[first + i] = 0;
+  }
+  children[node] = first;
+  counts[node] = child_moves.size();
+  return true;
+}
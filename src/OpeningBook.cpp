@@ -0,0 +1,140 @@
+#include <OpeningBook.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+  uint64_t readBig(const uint8_t *p, int bytes) {
+    uint64_t value = 0;
+    for(int i=0;i<bytes;i++) value = (value << 8) | p[i];
+    return value;
+  }
+
+  void writeBig(uint8_t *p, uint64_t value, int bytes) {
+    for(int i=bytes - 1;i>=0;i--) {
+      p[i] = value & 0xff;
+      value >>= 8;
+    }
+  }
+
+  int polyglotSquare(int sq) {
+    // Position counts from a8, Polyglot from a1
+    return sq ^ 56;
+  }
+}
+
+OpeningBook::OpeningBook() : data(nullptr), entries(0), mapped(0) {}
+
+OpeningBook::~OpeningBook() {
+  close();
+}
+
+bool OpeningBook::open(const std::string &path, std::string &error) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd == -1) {
+    error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size == 0 || st.st_size % ENTRY_SIZE != 0) {
+    error = path + " is not a Polyglot book";
+    ::close(fd);
+    return false;
+  }
+
+  // Pages are read in as lookups touch them; the mapping outlives the descriptor
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(p == MAP_FAILED) {
+    error = "cannot map " + path + ": " + strerror(errno);
+    return false;
+  }
+  madvise(p, st.st_size, MADV_RANDOM);
+
+  data = (const uint8_t *)p;
+  mapped = st.st_size;
+  entries = mapped / ENTRY_SIZE;
+  return true;
+}
+
+void OpeningBook::close() {
+  if(data != nullptr) munmap((void *)data, mapped);
+  data = nullptr;
+  entries = 0;
+  mapped = 0;
+}
+
+OpeningBook::Entry OpeningBook::entry(uint64_t i) const {
+  const uint8_t *p = data + i * ENTRY_SIZE;
+  return {readBig(p, 8), (uint16_t)readBig(p + 8, 2), (uint16_t)readBig(p + 10, 2)};
+}
+
+std::vector<OpeningBook::Entry> OpeningBook::lookup(uint64_t key) const {
+  // First entry with the key, then every one after it that shares it
+  uint64_t lo = 0, hi = entries;
+  while(lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(readBig(data + mid * ENTRY_SIZE, 8) < key) lo = mid + 1;
+    else hi = mid;
+  }
+
+  std::vector<Entry> found;
+  for(uint64_t i=lo;i<entries;i++) {
+    Entry e = entry(i);
+    if(e.key != key) break;
+    found.push_back(e);
+  }
+  return found;
+}
+
+Move OpeningBook::probe(Game &game, std::mt19937 &rng) const {
+  if(!isOpen()) return MOVE_NONE;
+
+  // Entries whose move is not legal here (a key collision) are left out of the draw
+  std::vector<std::pair<Move, int>> moves;
+  int total = 0;
+  for(const Entry &e: lookup(game.getKey())) {
+    Move m = decodeMove(game, e.move);
+    if(m == MOVE_NONE || e.weight == 0) continue;
+    moves.push_back({m, e.weight});
+    total += e.weight;
+  }
+  if(total == 0) return MOVE_NONE;
+
+  int pick = std::uniform_int_distribution<int>(0, total - 1)(rng);
+  for(const auto &[m, weight]: moves) {
+    if(pick < weight) return m;
+    pick -= weight;
+  }
+  return MOVE_NONE;
+}
+
+uint16_t OpeningBook::encodeMove(Move m) {
+  int from = moveFrom(m), to = moveTo(m);
+  if(moveFlag(m) == MOVE_CASTLING) to = makeSquare(squareX(to) == 6 ? 7 : 0, squareY(to));
+
+  uint16_t move = polyglotSquare(to) | (polyglotSquare(from) << 6);
+  if(moveFlag(m) == MOVE_PROMOTION) move |= promotionType(m) << 12; // Knight 1 to queen 4, as PieceType
+  return move;
+}
+
+Move OpeningBook::decodeMove(Game &game, uint16_t move) {
+  for(Move m: game.getAllMoves()) {
+    if(encodeMove(m) == move) return m;
+  }
+  return MOVE_NONE;
+}
+
+void OpeningBook::writeEntry(uint8_t *out, const Entry &e) {
+  writeBig(out, e.key, 8);
+  writeBig(out + 8, e.move, 2);
+  writeBig(out + 10, e.weight, 2);
+  writeBig(out + 12, 0, 4);
+}
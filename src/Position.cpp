@@ -0,0 +1,77 @@
+#include <Position.hpp>
+
+Position::Position() {
+  clear();
+}
+
+void Position::clear() {
+  for(int c=0;c<2;c++) {
+    for(int t=0;t<6;t++) pieces[c][t] = 0;
+    occupied[c] = 0;
+  }
+  all = 0;
+  for(int i=0;i<64;i++) board[i] = NO_PIECE;
+}
+
+void Position::put(int sq, Piece p) {
+  if(p == NO_PIECE) return;
+  Bitboard b = squareBB(sq);
+  pieces[pieceColor(p)][pieceType(p)] |= b;
+  occupied[pieceColor(p)] |= b;
+  all |= b;
+  board[sq] = p;
+}
+
+void Position::remove(int sq) {
+  Piece p = board[sq];
+  if(p == NO_PIECE) return;
+  Bitboard b = squareBB(sq);
+  pieces[pieceColor(p)][pieceType(p)] ^= b;
+  occupied[pieceColor(p)] ^= b;
+  all ^= b;
+  board[sq] = NO_PIECE;
+}
+
+void Position::set(int sq, Piece p) {
+  remove(sq);
+  put(sq, p);
+}
+
+Bitboard Position::attackersTo(int sq, Bitboard occ) const {
+  Bitboard diag = pieces[WHITE][BISHOP] | pieces[BLACK][BISHOP] | pieces[WHITE][QUEEN] | pieces[BLACK][QUEEN];
+  Bitboard line = pieces[WHITE][ROOK] | pieces[BLACK][ROOK] | pieces[WHITE][QUEEN] | pieces[BLACK][QUEEN];
+
+  return (Attacks::PAWN[BLACK][sq] & pieces[WHITE][PAWN])
+    | (Attacks::PAWN[WHITE][sq] & pieces[BLACK][PAWN])
+    | (Attacks::KNIGHT[sq] & (pieces[WHITE][KNIGHT] | pieces[BLACK][KNIGHT]))
+    | (Attacks::KING[sq] & (pieces[WHITE][KING] | pieces[BLACK][KING]))
+    | (Attacks::bishop(sq, occ) & diag)
+    | (Attacks::rook(sq, occ) & line);
+}
+
+bool Position::isAttacked(int sq, int by, Bitboard occ) const {
+  // A pawn of color `by` attacks sq iff a pawn of the other color on sq would attack it
+  if(Attacks::PAWN[by ^ 1][sq] & pieces[by][PAWN]) return true;
+  if(Attacks::KNIGHT[sq] & pieces[by][KNIGHT]) return true;
+  if(Attacks::KING[sq] & pieces[by][KING]) return true;
+  if(Attacks::bishop(sq, occ) & (pieces[by][BISHOP] | pieces[by][QUEEN])) return true;
+  if(Attacks::rook(sq, occ) & (pieces[by][ROOK] | pieces[by][QUEEN])) return true;
+  return false;
+}
+
+std::string Position::pieceName(Piece p) {
+  if(p == NO_PIECE) return "";
+  const char types[] = "pnbrqk";
+  std::string name = (pieceColor(p) == WHITE ? "w" : "b");
+  name += types[pieceType(p)];
+  return name;
+}
+
+Piece Position::pieceFromName(const std::string &name) {
+  if(name.size() != 2) return NO_PIECE;
+  const std::string types = "pnbrqk";
+  int color = (name[0] == 'w' ? WHITE : BLACK);
+  size_t type = types.find(name[1]);
+  if(type == std::string::npos) return NO_PIECE;
+  return makePiece(color, type);
+}
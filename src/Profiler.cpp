@@ -0,0 +1,168 @@
+#include <Profiler.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Profiler {
+  std::atomic<bool> hardware_enabled(false);
+
+  namespace {
+    std::mutex registry_lock;
+    Site *registry = nullptr;
+
+    // Reference points to turn ticks into seconds at report time
+    const uint64_t start_ticks = ticks();
+    const auto start_time = std::chrono::steady_clock::now();
+
+    struct HardwareGroup {
+      int leader = -1; // cycles, read together with the cache misses
+      int misses = -1;
+      bool tried = false;
+
+      ~HardwareGroup() {
+#ifdef __linux__
+        if(misses != -1) close(misses);
+        if(leader != -1) close(leader);
+#endif
+      }
+    };
+
+    thread_local HardwareGroup group;
+
+#ifdef __linux__
+    int openCounter(uint64_t config, int leader) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = config;
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.disabled = (leader == -1);
+      return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+    }
+#endif
+
+    bool openGroup() {
+      // Counters are per thread, so each thread opens its own group once
+      if(group.tried) return group.leader != -1;
+      group.tried = true;
+#ifdef __linux__
+      group.leader = openCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+      if(group.leader == -1) return false;
+      group.misses = openCounter(PERF_COUNT_HW_CACHE_MISSES, group.leader);
+      if(group.misses == -1) {
+        close(group.leader);
+        group.leader = -1;
+        return false;
+      }
+      ioctl(group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    const bool hardware_from_env = [] {
+      const char *env = getenv("CHESS_PROFILE_HW");
+      if(!ENABLED || env == nullptr || strcmp(env, "0") == 0) return false;
+      if(openGroup()) {
+        hardware_enabled = true;
+        return true;
+      }
+      std::cerr << "Profiler: hardware counters unavailable (perf_event_open failed)\n";
+      return false;
+    }();
+  }
+
+  Site::Site(const char *name): name(name) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    next = registry;
+    registry = this;
+  }
+
+  bool enableHardware() {
+    if(!openGroup()) return false;
+    hardware_enabled = true;
+    return true;
+  }
+
+  Counters readHardware() {
+    Counters c;
+    if(!openGroup()) return c;
+#ifdef __linux__
+    uint64_t values[3]; // nr, cycles, cache misses
+    if(read(group.leader, values, sizeof(values)) == sizeof(values)) {
+      c.cycles = values[1];
+      c.cache_misses = values[2];
+    }
+#endif
+    return c;
+  }
+
+  void report(std::ostream &out) {
+    out << "----------------------\n";
+    out << "PERF ANALYSIS\n\n";
+
+    if(!ENABLED) {
+      out << "Profiler not built in (make clean && make PROFILE=1)\n\n";
+      return;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    uint64_t elapsed_ticks = ticks() - start_ticks;
+    double ticks_per_sec = (seconds > 0 && elapsed_ticks > 0 ? elapsed_ticks / seconds : 1e9);
+
+    std::vector<Site *> sites;
+    {
+      std::lock_guard<std::mutex> guard(registry_lock);
+      for(Site *s=registry; s!=nullptr; s=s->next) sites.push_back(s);
+    }
+    std::sort(sites.begin(), sites.end(), [](Site *a, Site *b) { return a->ticks > b->ticks; });
+
+    bool hw = hardware_enabled.load();
+    // Formatted apart so the caller's stream keeps its own flags and precision
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(3);
+    for(Site *s: sites) {
+      uint64_t calls = s->calls;
+      if(calls == 0) continue;
+      double total = s->ticks / ticks_per_sec;
+
+      text << "Function: " << s->name << "\n";
+      text << "* Total time:     " << total << "s\n";
+      text << "* function calls: " << calls << "\n";
+      text << "* average time:   " << (total / calls) * 1e6 << "us\n";
+      text << "* ticks per call: " << (double)s->ticks / calls << "\n";
+      if(hw) {
+        text << "* cycles:         " << s->cycles << " (" << (double)s->cycles / calls << " per call)\n";
+        text << "* cache misses:   " << s->cache_misses << " (" << (double)s->cache_misses / calls << " per call)\n";
+      }
+      text << "\n";
+    }
+    out << text.str();
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    for(Site *s=registry; s!=nullptr; s=s->next) {
+      s->calls = 0;
+      s->ticks = 0;
+      s->cycles = 0;
+      s->cache_misses = 0;
+    }
+  }
+}
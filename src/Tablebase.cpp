@@ -0,0 +1,268 @@
+#include <Tablebase.hpp>
+#include <Evaluation.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+  // Piece order of names and indices after the kings
+  const int ORDER[5] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+  const char LETTER[] = "PNBRQK"; // By PieceType
+
+  Bitboard flipFiles(Bitboard b) {
+    // sq ^ 7 for every square: bits reversed within each rank
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return b;
+  }
+
+  int compareSides(const int *a, const int *b) {
+    // Positive when a is the stronger side
+    int va = 0, vb = 0;
+    for(int t=PAWN;t<KING;t++) {
+      va += a[t] * Evaluation::VALUE[t];
+      vb += b[t] * Evaluation::VALUE[t];
+    }
+    if(va != vb) return va - vb;
+    for(int t: ORDER) {
+      if(a[t] != b[t]) return a[t] - b[t];
+    }
+    return 0;
+  }
+
+  Tablebase::Material canonical(const int (&white)[6], const int (&black)[6], bool &swap) {
+    Tablebase::Material m;
+    swap = compareSides(white, black) < 0;
+    m.men = 0;
+    for(int t=PAWN;t<=KING;t++) {
+      m.count[0][t] = swap ? black[t] : white[t];
+      m.count[1][t] = swap ? white[t] : black[t];
+      m.men += white[t] + black[t];
+    }
+    return m;
+  }
+}
+
+namespace Tablebase {
+  uint32_t Material::key() const {
+    uint32_t key = 0;
+    for(int side=0;side<2;side++) {
+      for(int t: ORDER) key = (key << 3) | count[side][t];
+    }
+    return key;
+  }
+
+  std::string Material::name() const {
+    std::string name;
+    for(int side=0;side<2;side++) {
+      if(side == 1) name += 'v';
+      name += 'K';
+      for(int t: ORDER) name += std::string(count[side][t], LETTER[t]);
+    }
+    return name;
+  }
+
+  uint64_t Material::size() const {
+    return 2ULL * KING_SQUARES << (6 * (men - 1));
+  }
+
+  Material Material::of(const Position &pos, bool &swap) {
+    int white[6], black[6];
+    for(int t=PAWN;t<=KING;t++) {
+      white[t] = popCount(pos.byType(WHITE, t));
+      black[t] = popCount(pos.byType(BLACK, t));
+    }
+    return canonical(white, black, swap);
+  }
+
+  bool Material::parse(const std::string &name, Material &m) {
+    size_t v = name.find('v');
+    if(v == std::string::npos) return false;
+    int sides[2][6] = {};
+    std::string parts[2] = {name.substr(0, v), name.substr(v + 1)};
+    for(int side=0;side<2;side++) {
+      if(parts[side].empty() || parts[side][0] != 'K') return false;
+      sides[side][KING] = 1;
+      for(size_t i=1;i<parts[side].size();i++) {
+        const char *letter = strchr(LETTER, parts[side][i]);
+        if(letter == nullptr || *letter == 'K') return false;
+        sides[side][letter - LETTER]++;
+      }
+    }
+    bool swap;
+    m = canonical(sides[0], sides[1], swap);
+    for(int t=PAWN;t<KING;t++) {
+      if(m.count[0][t] > 7 || m.count[1][t] > 7) return false;
+    }
+    return m.men <= MAX_MEN;
+  }
+
+  uint64_t index(const Position &pos, int stm, bool swap) {
+    int strong = swap ? BLACK : WHITE;
+    auto board = [&](int side, int type) {
+      Bitboard b = pos.byType(strong ^ side, type);
+      return swap ? __builtin_bswap64(b) : b; // sq ^ 56
+    };
+
+    int king = lsb(board(0, KING));
+    bool mirror = squareX(king) > 3;
+    if(mirror) king ^= 7;
+
+    uint64_t idx = (stm ^ strong) * KING_SQUARES + squareY(king) * 4 + squareX(king);
+    idx = idx * 64 + (lsb(board(1, KING)) ^ (mirror ? 7 : 0));
+    for(int side=0;side<2;side++) {
+      for(int t: ORDER) {
+        Bitboard b = board(side, t);
+        if(mirror) b = flipFiles(b);
+        while(b) idx = idx * 64 + popLsb(b);
+      }
+    }
+    return idx;
+  }
+
+  bool decode(uint64_t index, const Material &m, Position &pos, int &stm) {
+    // Pieces in index order, after the strong king
+    int side[MAX_MEN], type[MAX_MEN], sq[MAX_MEN];
+    int n = 0;
+    side[n] = 1;
+    type[n++] = KING;
+    for(int s=0;s<2;s++) {
+      for(int t: ORDER) {
+        for(int i=0;i<m.count[s][t];i++) {
+          side[n] = s;
+          type[n++] = t;
+        }
+      }
+    }
+    for(int i=n - 1;i>=0;i--) {
+      sq[i] = index % 64;
+      index /= 64;
+    }
+    int king = index % KING_SQUARES;
+    stm = index / KING_SQUARES;
+
+    Bitboard taken = squareBB(makeSquare(king % 4, king / 4));
+    for(int i=0;i<n;i++) {
+      if(taken & squareBB(sq[i])) return false;
+      if(type[i] == PAWN && (squareY(sq[i]) == 0 || squareY(sq[i]) == 7)) return false;
+      // Identical pieces are stored once, in increasing square order
+      if(i > 0 && side[i] == side[i - 1] && type[i] == type[i - 1] && sq[i] < sq[i - 1]) return false;
+      taken |= squareBB(sq[i]);
+    }
+
+    pos.clear();
+    pos.put(makeSquare(king % 4, king / 4), makePiece(WHITE, KING));
+    for(int i=0;i<n;i++) pos.put(sq[i], makePiece(side[i], type[i]));
+    return !pos.isAttacked(pos.kingSquare(stm ^ 1), stm);
+  }
+}
+
+EndgameTables::EndgameTables() : max_men(0) {}
+
+EndgameTables::~EndgameTables() {
+  close();
+}
+
+bool EndgameTables::open(const std::string &dir, std::string &error) {
+  close();
+  DIR *d = opendir(dir.c_str());
+  if(d == nullptr) {
+    error = "cannot open " + dir + ": " + strerror(errno);
+    return false;
+  }
+
+  bool ok = true;
+  while(dirent *e = readdir(d)) {
+    std::string file = e->d_name;
+    if(file.size() <= 3 || file.compare(file.size() - 3, 3, ".tb") != 0) continue;
+    std::string path = dir + "/" + file;
+    Tablebase::Material m;
+    if(!Tablebase::Material::parse(file.substr(0, file.size() - 3), m)) {
+      error = path + ": not a material name";
+      ok = false;
+      break;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd == -1) {
+      error = "cannot open " + path + ": " + strerror(errno);
+      ok = false;
+      break;
+    }
+    struct stat st;
+    uint64_t expected = Tablebase::HEADER_SIZE + m.size();
+    if(fstat(fd, &st) == -1 || (uint64_t)st.st_size != expected) {
+      error = path + " is not a " + m.name() + " table";
+      ::close(fd);
+      ok = false;
+      break;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED) {
+      error = "cannot map " + path + ": " + strerror(errno);
+      ok = false;
+      break;
+    }
+
+    const uint8_t *header = (const uint8_t *)p;
+    uint32_t version;
+    uint64_t entries;
+    memcpy(&version, header + 4, sizeof(version));
+    memcpy(&entries, header + 8, sizeof(entries));
+    if(memcmp(header, "CHTB", 4) || version != Tablebase::VERSION || entries != m.size()) {
+      error = path + ": not a version " + std::to_string(Tablebase::VERSION) + " table";
+      munmap(p, st.st_size);
+      ok = false;
+      break;
+    }
+    madvise(p, st.st_size, MADV_RANDOM);
+
+    tables[m.key()] = {header + Tablebase::HEADER_SIZE, (uint64_t)st.st_size};
+    max_men = std::max(max_men, m.men);
+  }
+  closedir(d);
+
+  if(!ok) close();
+  return ok;
+}
+
+void EndgameTables::close() {
+  for(const auto &[key, t]: tables) munmap((void *)(t.data - Tablebase::HEADER_SIZE), t.mapped);
+  tables.clear();
+  max_men = 0;
+}
+
+bool EndgameTables::probe(const Position &pos, int stm, uint8_t &value) const {
+  bool swap;
+  Tablebase::Material m = Tablebase::Material::of(pos, swap);
+  if(m.men == 2) {
+    value = Tablebase::DRAW;
+    return true;
+  }
+  auto it = tables.find(m.key());
+  if(it == tables.end()) return false;
+  value = it->second.data[Tablebase::index(pos, stm, swap)];
+  return true;
+}
+
+bool EndgameTables::probe(Game &game, double &score) const {
+  if(tables.empty() || game.getPieceCount() > max_men || game.hasSpecialRights()) return false;
+  int stm = game.isWhiteTurn() ? WHITE : BLACK;
+  uint8_t value;
+  if(!probe(game.getPosition(), stm, value)) return false;
+
+  double s = 0.0;
+  if(Tablebase::isWin(value)) s = Tablebase::WIN_SCORE - Tablebase::plies(value) * Tablebase::PLY_SCORE;
+  else if(Tablebase::isLoss(value)) s = -(Tablebase::WIN_SCORE - Tablebase::plies(value) * Tablebase::PLY_SCORE);
+  score = (stm == WHITE ? s : -s);
+  return true;
+}
@@ -0,0 +1,146 @@
+#include <TranspositionTable.hpp>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+
+TranspositionTable::TranspositionTable(int size_mb) {
+  resize(size_mb);
+}
+
+void TranspositionTable::resize(int size_mb) {
+  uint64_t bytes = (uint64_t)std::max(size_mb, 1) << 20;
+  uint64_t buckets = 1;
+  while(buckets * 2 * BUCKET_SIZE * sizeof(Slot) <= bytes) buckets *= 2;
+
+  size = buckets * BUCKET_SIZE;
+  table = std::make_unique<Slot[]>(size);
+  mask = buckets - 1;
+  clear();
+}
+
+void TranspositionTable::clear() {
+  for(uint64_t i=0;i<size;i++) {
+    table[i].check.store(0, std::memory_order_relaxed);
+    table[i].data.store(0, std::memory_order_relaxed);
+  }
+  generation = 0;
+}
+
+void TranspositionTable::newSearch() {
+  // 6 bits of generation are kept in each entry
+  generation = (generation + 1) & 63;
+}
+
+TranspositionTable::Slot *TranspositionTable::bucket(uint64_t key) const {
+  return &table[(key & mask) * BUCKET_SIZE];
+}
+
+uint64_t TranspositionTable::pack(const TTEntry &e) {
+  uint32_t score_bits;
+  memcpy(&score_bits, &e.score, sizeof(score_bits));
+  return (uint64_t)score_bits | ((uint64_t)e.move << 32) | ((uint64_t)(uint8_t)e.depth << 48)
+    | ((uint64_t)e.genBound << 56);
+}
+
+TTEntry TranspositionTable::unpack(uint64_t key, uint64_t data) {
+  TTEntry e;
+  uint32_t score_bits = data & 0xffffffff;
+  e.key = key;
+  memcpy(&e.score, &score_bits, sizeof(score_bits));
+  e.move = (data >> 32) & 0xffff;
+  e.depth = (int8_t)((data >> 48) & 0xff);
+  e.genBound = data >> 56;
+  return e;
+}
+
+bool TranspositionTable::read(const Slot &slot, TTEntry &entry) {
+  // False for an empty slot
+  uint64_t data = slot.data.load(std::memory_order_relaxed);
+  uint64_t key = slot.check.load(std::memory_order_relaxed) ^ data;
+  entry = unpack(key, data);
+  return entry.bound() != BOUND_NONE;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry, TTStats &stats) const {
+  Slot *b = bucket(key);
+  bool used = false;
+  for(int i=0;i<BUCKET_SIZE;i++) {
+    TTEntry e;
+    if(!read(b[i], e)) continue;
+    if(e.key == key) {
+      stats.hits++;
+      entry = e;
+      return true;
+    }
+    used = true;
+  }
+  stats.misses++;
+  if(used) stats.collisions++;
+  return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, double score, uint16_t move, TTStats &stats) {
+  /*
+    Replacement policy: the first slot of a bucket keeps the deepest entry of
+    the current search, the second one is always replaced.
+  */
+  Slot *b = bucket(key);
+  TTEntry e[BUCKET_SIZE];
+  bool used[BUCKET_SIZE];
+  for(int i=0;i<BUCKET_SIZE;i++) used[i] = read(b[i], e[i]);
+
+  int slot = -1;
+  for(int i=0;i<BUCKET_SIZE;i++) {
+    if(used[i] && e[i].key == key) {
+      slot = i;
+      if(move == 0) move = e[i].move; // Keep the best move we already know
+      break;
+    }
+  }
+
+  if(slot == -1) {
+    bool stale = (!used[0] || e[0].generation() != generation);
+    if(stale || depth >= e[0].depth) {
+      // The evicted deep entry still gets the always-replace slot
+      if(!stale) {
+        b[1].check.store(e[0].key ^ pack(e[0]), std::memory_order_relaxed);
+        b[1].data.store(pack(e[0]), std::memory_order_relaxed);
+      }
+      slot = 0;
+    } else {
+      slot = 1;
+    }
+  }
+
+  TTEntry entry = {key, (float)score, move, (int8_t)depth, (uint8_t)((generation << 2) | bound)};
+  uint64_t data = pack(entry);
+  b[slot].check.store(key ^ data, std::memory_order_relaxed);
+  b[slot].data.store(data, std::memory_order_relaxed);
+  stats.stores++;
+}
+
+int TranspositionTable::hashfull() const {
+  // Permille of the first 1000 entries used by the current search
+  int used = 0;
+  int total = std::min<uint64_t>(1000, size);
+  for(int i=0;i<total;i++) {
+    TTEntry e;
+    if(read(table[i], e) && e.generation() == generation) used++;
+  }
+  return used * 1000 / total;
+}
+
+void TranspositionTable::report(const TTStats &stats) const {
+  uint64_t probes = stats.hits + stats.misses;
+  double hit_rate = (probes == 0 ? 0.0 : 100.0 * stats.hits / probes);
+
+  // Formatted apart so std::cerr keeps its own flags and precision
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  out << "TT: " << probes << " probes, " << stats.hits << " hits (" << hit_rate << "%), ";
+  out << stats.misses << " misses, " << stats.collisions << " collisions, ";
+  out << stats.stores << " stores, hashfull " << hashfull() << "\n";
+  std::cerr << out.str();
+}
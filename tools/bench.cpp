@@ -0,0 +1,217 @@
+#include <Engine.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+#include <sys/resource.h>
+
+/*
+  Reproducible engine benchmark: searches a fixed set of positions at
+  fixed depth with a fixed seed, one JSON object per position on stdout
+  and a summary object at the end.
+
+  ./bench [--depth N] [--movetime SEC] [--threads N] [--seed S] [--hash MB] [--tree MB] [--filter CATEGORY]
+          [--no-null-move] [--no-lmr] [--no-futility] [--nnue FILE] [--tb DIR]
+
+  With --movetime or more than one thread, node counts are no longer
+  reproducible. With --tb, positions the endgame tables cover are not
+  searched at all (depth 0). "allocations" counts the calls to the global
+  operator new during the search, on every thread; setting up the engine
+  (TT, tree arena) is not included.
+*/
+
+std::atomic<uint64_t> allocations{0};
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+struct BenchCase {
+  std::string name;
+  std::string category;
+  std::string fen;
+  std::vector<std::string> best_moves; // Empty: no known answer, only speed is measured
+};
+
+const std::vector<BenchCase> SUITE = {
+  {"italian", "middlegame", "r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3", {}},
+  {"kiwipete", "middlegame", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", {}},
+  {"closed", "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", {}},
+  {"rook-ending", "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", {}},
+  {"krk-mate", "endgame", "7k/8/6K1/8/8/8/8/R7 w - - 0 1", {"a1a8"}},
+  {"krk-mate-in-2", "endgame", "7k/8/5K2/8/8/8/8/6R1 w - - 0 1", {"f6f7"}},
+  {"scholar", "tactical", "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", {"h5f7"}},
+  {"back-rank", "tactical", "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", {"d1d8"}},
+  {"knight-fork", "tactical", "2q3k1/8/8/3N4/8/8/5PPP/6K1 w - - 0 1", {"d5e7"}},
+  {"hanging-queen", "tactical", "4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1", {"d2d5"}},
+};
+
+std::string jsonList(const std::vector<double> &values, int precision) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(precision) << "[";
+  for(int i=0;i<values.size();i++) out << (i ? "," : "") << values[i];
+  out << "]";
+  return out.str();
+}
+
+int main(int argc, char **argv) {
+  int depth = 5;
+  uint32_t seed = 1;
+  int hash_mb = 16;
+  int tree_mb = 256;
+  double move_time = 0.0;
+  int threads = 1;
+  std::string filter = "";
+  std::string nnue = "";
+  std::string tb = "";
+  SearchOptions options;
+
+  for(int i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "--depth") && i + 1 < argc) depth = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--movetime") && i + 1 < argc) move_time = atof(argv[++i]);
+    else if(!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--seed") && i + 1 < argc) seed = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--hash") && i + 1 < argc) hash_mb = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--tree") && i + 1 < argc) tree_mb = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+    else if(!strcmp(argv[i], "--no-null-move")) options.null_move = false;
+    else if(!strcmp(argv[i], "--no-lmr")) options.late_move_reductions = false;
+    else if(!strcmp(argv[i], "--no-futility")) options.futility = false;
+    else if(!strcmp(argv[i], "--nnue") && i + 1 < argc) nnue = argv[++i];
+    else if(!strcmp(argv[i], "--tb") && i + 1 < argc) tb = argv[++i];
+    else {
+      std::cerr << "usage: bench [--depth N] [--movetime SEC] [--threads N] [--seed S] [--hash MB] [--tree MB] [--filter CATEGORY]\n";
+      std::cerr << "             [--no-null-move] [--no-lmr] [--no-futility] [--nnue FILE] [--tb DIR]\n";
+      return 2;
+    }
+  }
+
+  std::shared_ptr<Nnue::Network> network;
+  if(nnue != "") {
+    std::string error;
+    network = std::make_shared<Nnue::Network>();
+    if(!network->load(nnue, error)) {
+      std::cerr << "bench: " << error << "\n";
+      return 1;
+    }
+  }
+
+  std::shared_ptr<EndgameTables> tablebase;
+  if(tb != "") {
+    std::string error;
+    tablebase = std::make_shared<EndgameTables>();
+    if(!tablebase->open(tb, error)) {
+      std::cerr << "bench: " << error << "\n";
+      return 1;
+    }
+  }
+
+  uint64_t total_nodes = 0;
+  uint64_t total_allocations = 0;
+  PruningStats total_pruning;
+  double total_sec = 0.0;
+  int solved = 0, with_answer = 0;
+
+  for(const auto &c: SUITE) {
+    if(filter != "" && filter != c.category && filter != c.name) continue;
+
+    Engine engine(hash_mb, tree_mb);
+    engine.setVerbose(false);
+    engine.setSeed(seed);
+    engine.setThreads(threads);
+    engine.setSearchOptions(options);
+    engine.setNetwork(network);
+    engine.setTablebase(tablebase);
+    engine.setPosition(c.fen);
+
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.move_time = move_time;
+    uint64_t allocations_before = allocations.load();
+    engine.getNextMove(limits);
+    uint64_t search_allocations = allocations.load() - allocations_before;
+    SearchResult result = engine.getLastSearch();
+
+    // The engine deepens iteratively, each completed depth is one entry
+    uint64_t nodes = result.nodes;
+    double elapsed = result.seconds;
+    double time_to_solve = -1.0;
+    std::vector<double> time_to_depth, nodes_per_depth;
+    uint64_t prev_nodes = 0;
+
+    for(const auto &it: engine.getLastIterations()) {
+      time_to_depth.push_back(it.seconds);
+      nodes_per_depth.push_back(it.nodes - prev_nodes);
+      prev_nodes = it.nodes;
+
+      std::string move = moveToString(it.move);
+      bool correct = std::find(c.best_moves.begin(), c.best_moves.end(), move) != c.best_moves.end();
+      if(!correct) time_to_solve = -1.0;
+      else if(time_to_solve < 0) time_to_solve = it.seconds;
+    }
+    if(std::find(c.best_moves.begin(), c.best_moves.end(), moveToString(result.move)) == c.best_moves.end()) {
+      time_to_solve = -1.0;
+    }
+    else if(engine.getLastIterations().empty()) {
+      time_to_solve = elapsed; // Played from the tables
+    }
+
+    bool has_answer = !c.best_moves.empty();
+    bool is_solved = has_answer && time_to_solve >= 0;
+    with_answer += has_answer;
+    solved += is_solved;
+    total_nodes += nodes;
+    total_allocations += search_allocations;
+    total_pruning += engine.getLastPruning();
+    total_sec += elapsed;
+
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "{\"name\":\"" << c.name << "\",\"category\":\"" << c.category << "\"";
+    std::cout << ",\"depth\":" << result.depth << ",\"seed\":" << seed << ",\"threads\":" << threads;
+    std::cout << ",\"nodes\":" << nodes << ",\"nodes_per_depth\":" << jsonList(nodes_per_depth, 0);
+    std::cout << ",\"seconds\":" << elapsed << ",\"nps\":" << (uint64_t)(nodes / std::max(elapsed, 1e-9));
+    std::cout << ",\"time_to_depth\":" << jsonList(time_to_depth, 4) << ",\"tree_nodes\":" << engine.getTreeNodes();
+    std::cout << ",\"allocations\":" << search_allocations;
+    std::cout << ",\"move\":\"" << moveToString(result.move) << "\",\"score\":" << result.score;
+    if(has_answer) {
+      std::cout << ",\"expected\":\"" << c.best_moves[0] << "\",\"solved\":" << (is_solved ? "true" : "false");
+      std::cout << ",\"time_to_solve\":";
+      if(is_solved) std::cout << time_to_solve;
+      else std::cout << "null";
+    }
+    std::cout << "}\n";
+  }
+
+  std::cout << "{\"summary\":true,\"depth\":" << depth << ",\"seed\":" << seed << ",\"threads\":" << threads;
+  std::cout << ",\"nodes\":" << total_nodes << ",\"seconds\":" << total_sec;
+  std::cout << ",\"nps\":" << (uint64_t)(total_nodes / std::max(total_sec, 1e-9));
+  std::cout << ",\"null_move\":" << (options.null_move ? "true" : "false");
+  std::cout << ",\"lmr\":" << (options.late_move_reductions ? "true" : "false");
+  std::cout << ",\"futility\":" << (options.futility ? "true" : "false");
+  std::cout << ",\"null_cutoffs\":" << total_pruning.null_cutoffs << ",\"reductions\":" << total_pruning.reductions;
+  std::cout << ",\"futile\":" << total_pruning.futile << ",\"tb_hits\":" << total_pruning.tb_hits;
+  std::cout << ",\"eval\":\"" << (network ? std::string("nnue-") + Nnue::Network::kernel() : "psq") << "\"";
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::cout << ",\"allocations\":" << total_allocations << ",\"peak_rss_kb\":" << usage.ru_maxrss;
+  std::cout << ",\"solved\":" << solved << ",\"with_answer\":" << with_answer << "}\n";
+
+  if(Profiler::ENABLED) Profiler::report(std::cerr);
+
+  return 0;
+}
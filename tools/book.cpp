@@ -0,0 +1,105 @@
+#include <OpeningBook.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+/*
+  Builds and reads opening books keyed by Game::getKey().
+
+  ./book --build book.bin [--plies N] < lines.txt
+      One game or opening line per input line, in coordinate notation from
+      the starting position (e2e4 e7e5 g1f3 ...). Every move played in the
+      first N plies (16 by default) is weighted by how often it was played.
+  ./book --show book.bin [m1 m2 ...]
+      The book moves of the position after the given moves.
+*/
+
+int build(const std::string &path, int plies) {
+  std::map<std::pair<uint64_t, uint16_t>, int> counts;
+  std::string line;
+  int lines = 0;
+
+  while(std::getline(std::cin, line)) {
+    lines++;
+    std::istringstream in(line);
+    std::string token;
+    Game game;
+    for(int ply=0;ply<plies && in >> token;ply++) {
+      Move m = game.getMove(token);
+      if(m == MOVE_NONE) {
+        std::cerr << "book: line " << lines << ": illegal move " << token << ", rest of the line skipped\n";
+        break;
+      }
+      counts[{game.getKey(), OpeningBook::encodeMove(m)}]++;
+      game.doAction(m);
+    }
+  }
+
+  std::vector<OpeningBook::Entry> entries;
+  for(const auto &[k, count]: counts) entries.push_back({k.first, k.second, (uint16_t)std::min(count, 65535)});
+  std::sort(entries.begin(), entries.end(), [](const OpeningBook::Entry &a, const OpeningBook::Entry &b) {
+    if(a.key != b.key) return a.key < b.key;
+    if(a.weight != b.weight) return a.weight > b.weight;
+    return a.move < b.move;
+  });
+
+  std::vector<uint8_t> bytes(entries.size() * OpeningBook::ENTRY_SIZE);
+  for(int i=0;i<entries.size();i++) OpeningBook::writeEntry(&bytes[i * OpeningBook::ENTRY_SIZE], entries[i]);
+
+  std::ofstream out(path, std::ios::binary);
+  out.write((const char *)bytes.data(), bytes.size());
+  if(!out) {
+    std::cerr << "book: cannot write " << path << "\n";
+    return 1;
+  }
+  std::cerr << "book: " << entries.size() << " entries from " << lines << " lines\n";
+  return 0;
+}
+
+int show(const std::string &path, const std::vector<std::string> &moves) {
+  OpeningBook book;
+  std::string error;
+  if(!book.open(path, error)) {
+    std::cerr << "book: " << error << "\n";
+    return 1;
+  }
+
+  Game game;
+  for(const std::string &token: moves) {
+    Move m = game.getMove(token);
+    if(m == MOVE_NONE) {
+      std::cerr << "book: illegal move " << token << "\n";
+      return 1;
+    }
+    game.doAction(m);
+  }
+
+  std::vector<OpeningBook::Entry> found = book.lookup(game.getKey());
+  int total = 0;
+  for(const auto &e: found) total += e.weight;
+  std::cout << std::hex << std::setfill('0') << "key " << std::setw(16) << game.getKey() << std::dec << "\n";
+  for(const auto &e: found) {
+    Move m = OpeningBook::decodeMove(game, e.move);
+    std::cout << (m == MOVE_NONE ? "(illegal)" : moveToString(m)) << " weight " << e.weight;
+    std::cout << std::fixed << std::setprecision(1) << " (" << 100.0 * e.weight / std::max(total, 1) << "%)\n";
+  }
+  if(found.empty()) std::cout << "out of book\n";
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if(argc >= 3 && !strcmp(argv[1], "--build")) {
+    int plies = 16;
+    if(argc == 5 && !strcmp(argv[3], "--plies")) plies = atoi(argv[4]);
+    if(argc == 3 || argc == 5) return build(argv[2], plies);
+  }
+  if(argc >= 3 && !strcmp(argv[1], "--show")) return show(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+
+  std::cerr << "usage: book --build book.bin [--plies N] < lines.txt\n";
+  std::cerr << "       book --show book.bin [m1 m2 ...]\n";
+  return 2;
+}
@@ -0,0 +1,282 @@
+#include <Engine.hpp>
+
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+
+#include "net.hpp"
+
+/*
+  Distributed root split: every root move is a work unit, scored by a pool
+  of worker processes (tools/worker.cpp) one depth at a time.
+
+  ./coordinator --workers ADDR[,ADDR...] [--fen FEN] [--moves "e2e4 e7e5"]
+                [--depth N] [--timeout SEC]
+
+  At each depth the best move of the previous one is searched first with the
+  full window, then the rest go out with the best score so far as the bound,
+  tightening as results arrive. A worker that disconnects or overruns the
+  timeout is dropped and its unit goes back in the queue; with no workers
+  left the coordinator scores the remaining units itself.
+*/
+
+struct WorkUnit {
+  Move move;
+  double score;
+  uint64_t nodes;
+};
+
+struct Worker {
+  std::string address;
+  LineSocket conn;
+  int unit = -1; // Index of the unit it is scoring, -1 when idle
+  std::chrono::steady_clock::time_point sent;
+};
+
+std::vector<std::string> split(const std::string &s, char sep) {
+  std::vector<std::string> parts;
+  std::stringstream in(s);
+  std::string part;
+  while(std::getline(in, part, sep)) {
+    if(part != "") parts.push_back(part);
+  }
+  return parts;
+}
+
+class Coordinator {
+private:
+  std::string fen;
+  std::vector<std::string> history;
+  std::vector<Worker> workers;
+  Engine local; // Fallback once every worker is gone
+  double timeout;
+  bool white;
+
+  bool better(double a, double b) const {
+    return white ? cmp(a, b) == 1 : cmp(a, b) == -1;
+  }
+
+  std::string positionCommand(const WorkUnit &unit) const {
+    std::string cmd = "position " + fen + " moves";
+    for(const auto &m: history) cmd += " " + m;
+    return cmd + " " + moveToString(unit.move);
+  }
+
+  void drop(Worker &w, std::deque<int> &queue, const std::string &reason) {
+    std::cerr << "coordinator: dropping worker " << w.address << " (" << reason << ")\n";
+    if(w.unit != -1) queue.push_front(w.unit);
+    w.unit = -1;
+    w.conn.shutdown();
+  }
+
+  bool dispatch(Worker &w, int index, std::vector<WorkUnit> &units, int depth, double bound) {
+    // The unit is a child of the root, so the bound is alpha for white and beta for black
+    double alpha = (white ? bound : -INF);
+    double beta = (white ? INF : bound);
+    std::ostringstream go;
+    go << std::setprecision(10) << "go " << depth - 1 << " " << alpha << " " << beta;
+
+    std::string reply;
+    if(!w.conn.sendLine(positionCommand(units[index])) || w.conn.readLine(reply, timeout > 0 ? timeout * 1000 : -1) != 1 || reply != "ok") {
+      return false;
+    }
+    if(!w.conn.sendLine(go.str())) return false;
+    w.unit = index;
+    w.sent = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void scoreLocally(WorkUnit &unit, int depth, double bound) {
+    local.setPosition(fen, false);
+    Game game(fen);
+    for(const auto &m: history) {
+      Move move = game.getMove(m);
+      game.doAction(move);
+      local.moveDone(move);
+    }
+    local.moveDone(unit.move);
+    unit.score = local.searchScore(depth - 1, white ? bound : -INF, white ? INF : bound);
+    unit.nodes = local.getLastSearch().nodes;
+  }
+
+public:
+  Coordinator(const std::string &fen, const std::vector<std::string> &history, double timeout)
+    : fen(fen), history(history), local(64), timeout(timeout) {
+    local.setVerbose(false);
+    local.setSeed(1);
+  }
+
+  void connect(const std::string &address) {
+    Worker w;
+    w.address = address;
+    w.conn = LineSocket(openSocket(address, false));
+    if(!w.conn.isOpen()) std::cerr << "coordinator: cannot reach worker " << address << "\n";
+    else workers.push_back(w);
+  }
+
+  int aliveWorkers() const {
+    int alive = 0;
+    for(const auto &w: workers) alive += w.conn.isOpen();
+    return alive;
+  }
+
+  void searchDepth(std::vector<WorkUnit> &units, int depth, int &best) {
+    std::deque<int> queue;
+    for(int i=0;i<units.size();i++) queue.push_back(i);
+
+    double bound = (white ? -INF : INF);
+    best = -1;
+    int done = 0;
+
+    auto record = [&](int index) {
+      // A refuted unit comes back as a bound no better than the best and never wins
+      done++;
+      if(best == -1 || better(units[index].score, units[best].score)) best = index;
+      bound = units[best].score;
+    };
+
+    while(done < units.size()) {
+      int busy = 0;
+      for(const auto &w: workers) busy += (w.conn.isOpen() && w.unit != -1);
+
+      // The first unit sets the bound for the others, so it goes out alone
+      bool bound_known = (depth == 1 || best != -1);
+      for(auto &w: workers) {
+        if(queue.empty() || !w.conn.isOpen() || w.unit != -1) continue;
+        if(!bound_known && busy > 0) break;
+        int index = queue.front();
+        queue.pop_front();
+        if(dispatch(w, index, units, depth, bound)) busy++;
+        else {
+          queue.push_front(index);
+          drop(w, queue, "send failed");
+        }
+      }
+
+      if(busy == 0) {
+        if(queue.empty()) break;
+        // Nobody left to send to
+        int index = queue.front();
+        queue.pop_front();
+        scoreLocally(units[index], depth, bound);
+        record(index);
+        continue;
+      }
+
+      std::vector<pollfd> fds;
+      for(const auto &w: workers) {
+        if(w.conn.isOpen() && w.unit != -1) fds.push_back({w.conn.getFd(), POLLIN, 0});
+      }
+      bool buffered = false;
+      for(const auto &w: workers) buffered |= (w.conn.isOpen() && w.unit != -1 && w.conn.hasLine());
+      if(!buffered) poll(fds.data(), fds.size(), 100);
+
+      auto now = std::chrono::steady_clock::now();
+      for(auto &w: workers) {
+        if(!w.conn.isOpen() || w.unit == -1) continue;
+
+        std::string reply;
+        int status = w.conn.readLine(reply, 0);
+        if(status == -1) {
+          drop(w, queue, "connection lost");
+        } else if(status == 1) {
+          std::istringstream in(reply);
+          std::string word;
+          WorkUnit &unit = units[w.unit];
+          if(in >> word && word == "score" && in >> unit.score >> word >> unit.nodes) {
+            int index = w.unit;
+            w.unit = -1;
+            record(index);
+          } else {
+            drop(w, queue, "bad reply: " + reply);
+          }
+        } else if(timeout > 0 && std::chrono::duration<double>(now - w.sent).count() > timeout) {
+          drop(w, queue, "timed out");
+        }
+      }
+    }
+  }
+
+  Move search(int max_depth) {
+    Game game(fen);
+    for(const auto &m: history) {
+      Move move = game.getMove(m);
+      if(move == MOVE_NONE) {
+        std::cerr << "coordinator: illegal move " << m << "\n";
+        return MOVE_NONE;
+      }
+      game.doAction(move);
+    }
+    white = game.isWhiteTurn();
+
+    std::vector<WorkUnit> units;
+    for(Move m: game.getAllMoves()) units.push_back({m, 0.0, 0});
+    if(units.empty()) return MOVE_NONE;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = 0;
+    Move best_move = units[0].move;
+
+    for(int depth=1;depth<=max_depth;depth++) {
+      int best;
+      searchDepth(units, depth, best);
+      for(const auto &u: units) nodes += u.nodes;
+
+      best_move = units[best].move;
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << std::fixed << std::setprecision(3) << "depth " << depth << " score " << units[best].score;
+      std::cout << " move " << moveToString(best_move) << " nodes " << nodes << " time " << seconds << "s";
+      std::cout << " workers " << aliveWorkers() << std::endl;
+
+      // Next depth in this depth's order, refuted moves last
+      std::stable_sort(units.begin(), units.end(), [&](const WorkUnit &a, const WorkUnit &b) {
+        return better(a.score, b.score);
+      });
+    }
+    return best_move;
+  }
+
+  void quit() {
+    for(auto &w: workers) {
+      if(w.conn.isOpen()) w.conn.sendLine("quit");
+      w.conn.shutdown();
+    }
+  }
+};
+
+int main(int argc, char **argv) {
+  std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+  std::string moves = "";
+  std::string addresses = "";
+  int depth = 5;
+  double timeout = 300.0;
+
+  for(int i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "--fen") && i + 1 < argc) fen = argv[++i];
+    else if(!strcmp(argv[i], "--moves") && i + 1 < argc) moves = argv[++i];
+    else if(!strcmp(argv[i], "--workers") && i + 1 < argc) addresses = argv[++i];
+    else if(!strcmp(argv[i], "--depth") && i + 1 < argc) depth = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--timeout") && i + 1 < argc) timeout = atof(argv[++i]);
+    else {
+      std::cerr << "usage: coordinator --workers ADDR[,ADDR...] [--fen FEN] [--moves \"m1 m2\"] [--depth N] [--timeout SEC]\n";
+      return 2;
+    }
+  }
+
+  std::string error;
+  if(!Game::isValidFen(fen, error)) {
+    std::cerr << "coordinator: bad --fen: " << error << "\n";
+    return 2;
+  }
+
+  Coordinator coordinator(fen, split(moves, ' '), timeout);
+  for(const auto &address: split(addresses, ',')) coordinator.connect(address);
+  if(coordinator.aliveWorkers() == 0) std::cerr << "coordinator: no workers, searching locally\n";
+
+  Move best = coordinator.search(depth);
+  coordinator.quit();
+
+  std::cout << "bestmove " << moveToString(best) << "\n";
+  return best == MOVE_NONE ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#ifndef NET_HPP
+#define NET_HPP
+
+#include <string>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+
+/*
+  Line based sockets for the distributed search tools. An address is either
+  a Unix socket path (anything with a '/') or [HOST:]PORT over TCP, on
+  127.0.0.1 unless a HOST is given, for listening too.
+*/
+
+inline bool isUnixAddress(const std::string &address) {
+  return address.find('/') != std::string::npos;
+}
+
+inline int openSocket(const std::string &address, bool listening) {
+  if(isUnixAddress(address)) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(address.size() >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, address.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd == -1) return -1;
+    if(listening) unlink(address.c_str());
+    int ok = (listening ? bind(fd, (sockaddr *)&addr, sizeof(addr)) : connect(fd, (sockaddr *)&addr, sizeof(addr)));
+    if(ok == -1 || (listening && listen(fd, 4) == -1)) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  std::string host = "127.0.0.1";
+  std::string port = address;
+  size_t colon = address.rfind(':');
+  if(colon != std::string::npos) {
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+  }
+
+  addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  int ok = -1;
+  if(fd != -1) {
+    if(listening) {
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      ok = bind(fd, res->ai_addr, res->ai_addrlen);
+      if(ok == 0) ok = listen(fd, 4);
+    } else {
+      ok = connect(fd, res->ai_addr, res->ai_addrlen);
+    }
+  }
+  freeaddrinfo(res);
+
+  if(ok == -1 && fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+class LineSocket {
+private:
+  int fd;
+  std::string buffer;
+
+public:
+  LineSocket(int fd = -1): fd(fd) {}
+
+  int getFd() const { return fd; }
+  bool isOpen() const { return fd != -1; }
+  bool hasLine() const { return buffer.find('\n') != std::string::npos; }
+
+  void shutdown() {
+    if(fd != -1) close(fd);
+    fd = -1;
+    buffer.clear();
+  }
+
+  bool sendLine(const std::string &line) {
+    std::string data = line + "\n";
+    size_t sent = 0;
+    while(sent < data.size()) {
+      ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if(n <= 0) return false;
+      sent += n;
+    }
+    return true;
+  }
+
+  int readLine(std::string &line, int timeout_ms = -1) {
+    // 1 with a line, 0 on timeout, -1 once the peer is gone
+    while(!hasLine()) {
+      pollfd p = {fd, POLLIN, 0};
+      int ready = poll(&p, 1, timeout_ms);
+      if(ready == 0) return 0;
+      if(ready < 0) return -1;
+
+      char chunk[4096];
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if(n <= 0) return -1;
+      buffer.append(chunk, n);
+    }
+    size_t end = buffer.find('\n');
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+    return 1;
+  }
+};
+
+#endif
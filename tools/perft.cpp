@@ -0,0 +1,185 @@
+#include <Game.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+/*
+  Headless move generator check: counts the leaf nodes of the legal move
+  tree through Game::doAction/undoAction and compares them with known
+  results.
+
+  ./perft                          built-in suite up to --depth (default 4)
+  ./perft --fen "<FEN>" --depth N  single position, --divide prints per root move
+  --threads N                      split root moves across N threads
+  --hash MB                        share a perft cache of MB megabytes
+*/
+
+struct PerftCase {
+  std::string name;
+  std::string fen;
+  std::vector<uint64_t> nodes; // nodes[d - 1] is perft(d)
+};
+
+const std::vector<PerftCase> SUITE = {
+  {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    {20, 400, 8902, 197281, 4865609, 119060324}},
+  {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    {48, 2039, 97862, 4085603, 193690690}},
+  {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    {14, 191, 2812, 43238, 674624, 11030083}},
+  {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    {6, 264, 9467, 422333, 15833292}},
+  {"talkchess", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    {44, 1486, 62379, 2103487, 89941194}},
+  {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    {46, 2079, 89890, 3894594, 164075551}},
+};
+
+class PerftHash {
+private:
+  // key ^ data lets a reader detect an entry torn by another thread
+  struct Entry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data; // nodes << 8 | depth
+  };
+  std::vector<Entry> table;
+  uint64_t mask;
+
+public:
+  PerftHash(int size_mb) {
+    uint64_t entries = 1;
+    while(entries * 2 * sizeof(Entry) <= ((uint64_t)size_mb << 20)) entries *= 2;
+    table = std::vector<Entry>(entries);
+    mask = entries - 1;
+  }
+
+  bool probe(uint64_t key, int depth, uint64_t &nodes) {
+    Entry &e = table[key & mask];
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    if((e.check.load(std::memory_order_relaxed) ^ data) != key) return false;
+    if((int)(data & 255) != depth) return false;
+    nodes = data >> 8;
+    return true;
+  }
+
+  void store(uint64_t key, int depth, uint64_t nodes) {
+    Entry &e = table[key & mask];
+    uint64_t data = (nodes << 8) | depth;
+    e.check.store(key ^ data, std::memory_order_relaxed);
+    e.data.store(data, std::memory_order_relaxed);
+  }
+};
+
+uint64_t perft(Game &game, int depth, PerftHash *hash) {
+  if(depth == 0) return 1;
+
+  const std::vector<Move> &moves = game.getAllMoves();
+  if(depth == 1) return moves.size(); // Bulk counting
+
+  uint64_t nodes = 0;
+  if(hash != nullptr && hash->probe(game.getKey(), depth, nodes)) return nodes;
+
+  for(Move m: moves) {
+    game.doAction(m);
+    nodes += perft(game, depth - 1, hash);
+    game.undoAction();
+  }
+
+  if(hash != nullptr) hash->store(game.getKey(), depth, nodes);
+  return nodes;
+}
+
+uint64_t perftRoot(Game &game, int depth, int threads, PerftHash *hash, bool divide) {
+  std::vector<Move> moves = game.getAllMoves();
+  std::vector<uint64_t> counts(moves.size(), 0);
+  std::atomic<int> next(0);
+
+  // Every thread plays the root moves it takes on its own copy of the game
+  auto worker = [&]() {
+    Game local = game;
+    for(int i=next++; i<(int)moves.size(); i=next++) {
+      local.doAction(moves[i]);
+      counts[i] = perft(local, depth - 1, hash);
+      local.undoAction();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for(int i=1;i<threads;i++) pool.emplace_back(worker);
+  worker();
+  for(auto &t: pool) t.join();
+
+  uint64_t nodes = 0;
+  for(int i=0;i<moves.size();i++) {
+    if(divide) std::cout << moveToString(moves[i]) << ": " << counts[i] << "\n";
+    nodes += counts[i];
+  }
+  return nodes;
+}
+
+int main(int argc, char **argv) {
+  std::string fen = "";
+  int max_depth = 4;
+  int threads = 1;
+  int hash_mb = 0;
+  bool divide = false;
+
+  for(int i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "--fen") && i + 1 < argc) fen = argv[++i];
+    else if(!strcmp(argv[i], "--depth") && i + 1 < argc) max_depth = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--threads") && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if(!strcmp(argv[i], "--hash") && i + 1 < argc) hash_mb = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "--divide")) divide = true;
+    else {
+      std::cerr << "usage: perft [--fen FEN] [--depth N] [--divide] [--threads N] [--hash MB]\n";
+      return 2;
+    }
+  }
+
+  std::unique_ptr<PerftHash> hash;
+  if(hash_mb > 0) hash = std::make_unique<PerftHash>(hash_mb);
+
+  std::vector<PerftCase> cases = SUITE;
+  if(fen != "") cases = {{"fen", fen, {}}};
+
+  int failures = 0;
+  uint64_t total_nodes = 0;
+  double total_sec = 0.0;
+
+  for(const auto &c: cases) {
+    for(int depth=1;depth<=max_depth;depth++) {
+      if(fen == "" && depth > (int)c.nodes.size()) break;
+      if(fen != "" && depth < max_depth) continue;
+
+      Game game(c.fen);
+      auto start = std::chrono::steady_clock::now();
+      uint64_t nodes = perftRoot(game, depth, threads, hash.get(), divide && depth == max_depth);
+      double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      total_nodes += nodes;
+      total_sec += sec;
+
+      std::cout << std::left << std::setw(12) << c.name << " depth " << depth;
+      std::cout << std::right << std::setw(12) << nodes;
+      if(depth <= (int)c.nodes.size()) {
+        bool ok = (nodes == c.nodes[depth - 1]);
+        if(!ok) failures++;
+        std::cout << (ok ? "  ok  " : "  FAIL (expected " + std::to_string(c.nodes[depth - 1]) + ")");
+      }
+      std::cout << std::fixed << std::setprecision(3) << "  " << sec << "s  ";
+      std::cout << (uint64_t)(nodes / std::max(sec, 1e-9)) << " nps\n";
+    }
+  }
+
+  std::cout << "total " << total_nodes << " nodes in " << std::fixed << std::setprecision(3) << total_sec << "s, ";
+  std::cout << (uint64_t)(total_nodes / std::max(total_sec, 1e-9)) << " nps";
+  std::cout << (failures ? ", " + std::to_string(failures) + " FAILED" : "") << "\n";
+
+  if(Profiler::ENABLED) Profiler::report(std::cerr);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+#include <Tablebase.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+/*
+  Builds endgame tables by retrograde analysis, see Tablebase.hpp.
+
+  ./tbgen DIR MATERIAL...     e.g. ./tbgen tb KQvK KRvK KPvK
+  ./tbgen DIR --men N         every material with up to N men (N <= 5)
+
+  Tables a material converts into (captures, promotions) are built first
+  when DIR does not have them yet. Tables take 2 x 32 x 64^(men - 1) bytes
+  each (16 MB with 4 men, 1 GB with 5) and about three times that while
+  being built.
+
+  Every position first counts its moves. Moves leaving the table
+  (captures, promotions) are looked up in the smaller tables: into a won
+  position for the opponent they only push back how late the position can
+  be lost, anything else counts like a move within the table, and a move
+  into a lost position for the opponent wins. Checkmates are lost in 0.
+  Then, one ply at a time from 0: the predecessors (un-moves of the side
+  that just moved, no un-captures) of a position lost in p plies win in
+  p + 1; those of a position won in p plies have one move less left, and
+  lose in p + 1 plies once none is left. What is never reached is a draw.
+*/
+
+namespace {
+  const int MAX_PLIES = 254; // Mated in 127 moves, LOSS + 127
+
+  Bitboard attacks(int type, int sq, Bitboard occ) {
+    switch(type) {
+      case KNIGHT: return Attacks::KNIGHT[sq];
+      case BISHOP: return Attacks::bishop(sq, occ);
+      case ROOK: return Attacks::rook(sq, occ);
+      case QUEEN: return Attacks::bishop(sq, occ) | Attacks::rook(sq, occ);
+      default: return Attacks::KING[sq];
+    }
+  }
+
+  // f(next, same_material) for every legal move of us
+  template<typename F>
+  void forEachMove(const Position &pos, int us, F f) {
+    int them = us ^ 1;
+    for(int t=PAWN;t<=KING;t++) {
+      Bitboard pieces = pos.byType(us, t);
+      while(pieces) {
+        int from = popLsb(pieces);
+        Bitboard targets;
+        if(t == PAWN) {
+          int dir = (us == WHITE ? -8 : 8);
+          targets = Attacks::PAWN[us][from] & pos.occupied[them];
+          if(pos.at(from + dir) == NO_PIECE) {
+            targets |= squareBB(from + dir);
+            int start = (us == WHITE ? 6 : 1);
+            if(squareY(from) == start && pos.at(from + 2 * dir) == NO_PIECE) targets |= squareBB(from + 2 * dir);
+          }
+        }
+        else targets = attacks(t, from, pos.all) & ~pos.occupied[us];
+
+        while(targets) {
+          int to = popLsb(targets);
+          bool capture = pos.at(to) != NO_PIECE;
+          bool promotion = (t == PAWN && (squareY(to) == 0 || squareY(to) == 7));
+          for(int p=(promotion ? KNIGHT : t);p<=(promotion ? QUEEN : t);p++) {
+            Position next = pos;
+            next.remove(from);
+            next.set(to, makePiece(us, p));
+            if(next.isAttacked(next.kingSquare(us), them)) break;
+            f(next, !capture && !promotion);
+          }
+        }
+      }
+    }
+  }
+
+  // f(previous) for every way us could have just moved into pos without capturing or promoting
+  template<typename F>
+  void forEachUnmove(const Position &pos, int us, F f) {
+    for(int t=PAWN;t<=KING;t++) {
+      Bitboard pieces = pos.byType(us, t);
+      while(pieces) {
+        int to = popLsb(pieces);
+        Bitboard sources;
+        if(t == PAWN) {
+          // Back towards its own side, never onto its back rank
+          int dir = (us == WHITE ? 8 : -8);
+          int y = squareY(to + dir);
+          sources = 0;
+          if(y >= 1 && y <= 6 && pos.at(to + dir) == NO_PIECE) {
+            sources |= squareBB(to + dir);
+            int middle = (us == WHITE ? 4 : 3);
+            if(squareY(to) == middle && pos.at(to + 2 * dir) == NO_PIECE) sources |= squareBB(to + 2 * dir);
+          }
+        }
+        else sources = attacks(t, to, pos.all) & ~pos.all;
+
+        while(sources) {
+          int from = popLsb(sources);
+          Position previous = pos;
+          previous.remove(to);
+          previous.put(from, makePiece(us, t));
+          f(previous);
+        }
+      }
+    }
+  }
+
+  std::string path(const std::string &dir, const Tablebase::Material &m) {
+    return dir + "/" + m.name() + ".tb";
+  }
+
+  bool exists(const std::string &file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0;
+  }
+
+  std::string sideName(const int *count) {
+    std::string name = "K";
+    for(int t: {QUEEN, ROOK, BISHOP, KNIGHT, PAWN}) name += std::string(count[t], "PNBRQ"[t]);
+    return name;
+  }
+
+  std::vector<Tablebase::Material> subtables(const Tablebase::Material &m) {
+    // One piece captured, or one pawn promoted
+    std::vector<Tablebase::Material> found;
+    auto add = [&](const int (&count)[2][6]) {
+      Tablebase::Material sub;
+      Tablebase::Material::parse(sideName(count[0]) + "v" + sideName(count[1]), sub);
+      if(sub.men > 2) found.push_back(sub);
+    };
+    for(int side=0;side<2;side++) {
+      for(int t=PAWN;t<KING;t++) {
+        if(m.count[side][t] == 0) continue;
+        int count[2][6];
+        memcpy(count, m.count, sizeof(count));
+        count[side][t]--;
+        add(count);
+        if(t != PAWN) continue;
+        for(int p=KNIGHT;p<=QUEEN;p++) {
+          count[side][p]++;
+          add(count);
+          count[side][p]--;
+        }
+      }
+    }
+    return found;
+  }
+
+  bool write(const std::string &file, const std::vector<uint8_t> &value) {
+    uint8_t header[Tablebase::HEADER_SIZE];
+    uint64_t entries = value.size();
+    memcpy(header, "CHTB", 4);
+    memcpy(header + 4, &Tablebase::VERSION, sizeof(Tablebase::VERSION));
+    memcpy(header + 8, &entries, sizeof(entries));
+
+    std::ofstream out(file, std::ios::binary);
+    out.write((const char *)header, sizeof(header));
+    out.write((const char *)value.data(), value.size());
+    return (bool)out;
+  }
+
+  bool build(const std::string &dir, const Tablebase::Material &m) {
+    for(const Tablebase::Material &sub: subtables(m)) {
+      if(!exists(path(dir, sub)) && !build(dir, sub)) return false;
+    }
+
+    std::string error;
+    EndgameTables tables;
+    if(!tables.open(dir, error)) {
+      std::cerr << "tbgen: " << error << "\n";
+      return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t n = m.size();
+    std::vector<uint8_t> value(n, Tablebase::DRAW); // Until resolved: how late a loss can come at the earliest
+    std::vector<uint8_t> remaining(n, 0); // Moves not yet known to lose
+    std::vector<bool> resolved(n, false);
+    std::vector<std::vector<uint64_t>> queue(MAX_PLIES + 1); // By plies; odd wins, even losses
+    bool missing = false;
+
+    Position pos;
+    int stm;
+    for(uint64_t i=0;i<n;i++) {
+      if(!Tablebase::decode(i, m, pos, stm)) {
+        resolved[i] = true;
+        continue;
+      }
+
+      int moves = 0, count = 0, floor = 0;
+      forEachMove(pos, stm, [&](const Position &next, bool same) {
+        moves++;
+        if(same) {
+          count++;
+          return;
+        }
+        uint8_t v;
+        if(!tables.probe(next, stm ^ 1, v)) {
+          missing = true;
+          return;
+        }
+        if(Tablebase::isWin(v)) floor = std::max(floor, Tablebase::plies(v) + 1);
+        else {
+          count++;
+          if(Tablebase::isLoss(v)) queue[Tablebase::plies(v) + 1].push_back(i);
+        }
+      });
+
+      if(moves == 0) {
+        // Checkmated, or a stalemate that stays a draw
+        if(pos.isAttacked(pos.kingSquare(stm), stm ^ 1)) queue[0].push_back(i);
+        else resolved[i] = true;
+      }
+      else if(count == 0) queue[floor].push_back(i);
+      else {
+        remaining[i] = count;
+        value[i] = floor;
+      }
+    }
+    if(missing) {
+      std::cerr << "tbgen: " << m.name() << ": a smaller table is missing\n";
+      return false;
+    }
+
+    for(int p=0;p<=MAX_PLIES;p++) {
+      for(uint64_t i: queue[p]) {
+        if(resolved[i]) continue;
+        resolved[i] = true;
+        value[i] = Tablebase::fromPlies(p);
+
+        Tablebase::decode(i, m, pos, stm);
+        bool lost = (p % 2 == 0);
+        forEachUnmove(pos, stm ^ 1, [&](const Position &previous) {
+          uint64_t j = Tablebase::index(previous, stm ^ 1, false);
+          if(resolved[j]) return;
+          int next = lost ? p + 1 : std::max<int>(value[j], p + 1);
+          if(!lost && --remaining[j] > 0) return;
+          if(next > MAX_PLIES) {
+            missing = true;
+            return;
+          }
+          queue[next].push_back(j);
+        });
+      }
+      std::vector<uint64_t>().swap(queue[p]);
+    }
+    if(missing) {
+      std::cerr << "tbgen: " << m.name() << ": mates longer than " << MAX_PLIES / 2 << " moves do not fit\n";
+      return false;
+    }
+
+    // Never reached: draws
+    for(uint64_t i=0;i<n;i++) {
+      if(!resolved[i]) value[i] = Tablebase::DRAW;
+    }
+
+    if(!write(path(dir, m), value)) {
+      std::cerr << "tbgen: cannot write " << path(dir, m) << "\n";
+      return false;
+    }
+
+    // With the strong side to move: the first half of the table
+    uint64_t wins = 0, losses = 0, draws = 0;
+    int longest = 0;
+    for(uint64_t i=0;i<n / 2;i++) {
+      if(!Tablebase::decode(i, m, pos, stm)) continue;
+      if(Tablebase::isWin(value[i])) wins++;
+      else if(Tablebase::isLoss(value[i])) losses++;
+      else draws++;
+      if(Tablebase::isWin(value[i])) longest = std::max<int>(longest, value[i]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << m.name() << ": " << wins << " won, " << draws << " drawn, " << losses << " lost";
+    std::cerr << ", longest mate in " << longest << " (" << seconds << " s)\n";
+    return true;
+  }
+
+  void materials(int men, int slot, int (&count)[2][6], std::set<uint32_t> &seen, std::vector<Tablebase::Material> &out) {
+    // Every split of up to men - 2 pieces between the sides
+    const int slots[5] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+    if(slot == 10) {
+      Tablebase::Material m;
+      if(Tablebase::Material::parse(sideName(count[0]) + "v" + sideName(count[1]), m) && m.men > 2 && seen.insert(m.key()).second) {
+        out.push_back(m);
+      }
+      return;
+    }
+    int used = 2;
+    for(int side=0;side<2;side++) {
+      for(int t=PAWN;t<KING;t++) used += count[side][t];
+    }
+    for(int c=0;used + c<=men;c++) {
+      count[slot / 5][slots[slot % 5]] = c;
+      materials(men, slot + 1, count, seen, out);
+    }
+    count[slot / 5][slots[slot % 5]] = 0;
+  }
+}
+
+int main(int argc, char **argv) {
+  if(argc < 3) {
+    std::cerr << "usage: tbgen DIR MATERIAL...\n";
+    std::cerr << "       tbgen DIR --men N\n";
+    return 2;
+  }
+  std::string dir = argv[1];
+  mkdir(dir.c_str(), 0755);
+
+  std::vector<Tablebase::Material> todo;
+  if(!strcmp(argv[2], "--men") && argc == 4) {
+    int men = atoi(argv[3]);
+    if(men < 3 || men > Tablebase::MAX_MEN) {
+      std::cerr << "tbgen: --men goes from 3 to " << Tablebase::MAX_MEN << "\n";
+      return 2;
+    }
+    int count[2][6] = {};
+    std::set<uint32_t> seen;
+    materials(men, 0, count, seen, todo);
+  }
+  else {
+    for(int i=2;i<argc;i++) {
+      Tablebase::Material m;
+      if(!Tablebase::Material::parse(argv[i], m) || m.men < 3) {
+        std::cerr << "tbgen: " << argv[i] << " is not a material of 3 to " << Tablebase::MAX_MEN << " men\n";
+        return 2;
+      }
+      todo.push_back(m);
+    }
+  }
+
+  // Smaller tables first, so none is built twice
+  std::stable_sort(todo.begin(), todo.end(), [](const Tablebase::Material &a, const Tablebase::Material &b) {
+    return a.men < b.men;
+  });
+  for(const Tablebase::Material &m: todo) {
+    if(exists(path(dir, m))) continue;
+    if(!build(dir, m)) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <Engine.hpp>
+
+#include <cerrno>
+#include <iomanip>
+#include <sstream>
+
+#include "net.hpp"
+
+/*
+  Distributed search worker: scores the positions a coordinator sends it,
+  one connection at a time.
+
+  ./worker --listen PORT|HOST:PORT|/path/to.sock [--hash MB]
+
+  A bare PORT listens on 127.0.0.1 only. The protocol has no
+  authentication: give a HOST (e.g. 0.0.0.0:9001) to take coordinators
+  from other machines, on trusted networks only.
+
+  Protocol, one command per line:
+    position <fen> [moves <m1> <m2> ...]   ->  ok | error <reason>
+    go <depth> <alpha> <beta>              ->  score <score> nodes <nodes>
+    quit
+*/
+
+std::string handlePosition(Engine &engine, std::istringstream &in) {
+  std::string fen, token;
+  while(in >> token && token != "moves") fen += (fen == "" ? "" : " ") + token;
+
+  // Position and moves come off the network: checked on a Game of our own before the engine sees them
+  std::string error;
+  if(!Game::isValidFen(fen, error)) return "error bad position: " + error;
+  Game game(fen);
+  std::vector<Move> moves;
+  while(in >> token) {
+    Move m = game.getMove(token);
+    if(m == MOVE_NONE || !game.isAvailable(m)) return "error illegal move " + token;
+    game.doAction(m);
+    moves.push_back(m);
+  }
+
+  engine.setPosition(fen, false); // Keep the table between work units
+  for(Move m: moves) engine.moveDone(m);
+  return "ok";
+}
+
+std::string handleGo(Engine &engine, std::istringstream &in) {
+  int depth;
+  double alpha, beta;
+  if(!(in >> depth >> alpha >> beta)) return "error usage: go <depth> <alpha> <beta>";
+
+  double score = engine.searchScore(depth, alpha, beta);
+  std::ostringstream out;
+  out << std::setprecision(10) << "score " << score << " nodes " << engine.getLastSearch().nodes;
+  return out.str();
+}
+
+int main(int argc, char **argv) {
+  std::string address = "";
+  int hash_mb = 64;
+
+  for(int i=1;i<argc;i++) {
+    if(!strcmp(argv[i], "--listen") && i + 1 < argc) address = argv[++i];
+    else if(!strcmp(argv[i], "--hash") && i + 1 < argc) hash_mb = atoi(argv[++i]);
+    else address = "";
+  }
+  if(address == "") {
+    std::cerr << "usage: worker --listen PORT|HOST:PORT|/path/to.sock [--hash MB]\n";
+    return 2;
+  }
+
+  int server = openSocket(address, true);
+  if(server == -1) {
+    std::cerr << "worker: cannot listen on " << address << ": " << strerror(errno) << "\n";
+    return 1;
+  }
+  std::cerr << "worker: listening on " << address << "\n";
+
+  Engine engine(hash_mb);
+  engine.setVerbose(false);
+  engine.setSeed(1);
+
+  while(true) {
+    int fd = accept(server, nullptr, nullptr);
+    if(fd == -1) continue;
+    LineSocket conn(fd);
+
+    std::string line;
+    while(conn.readLine(line) == 1) {
+      std::istringstream in(line);
+      std::string command;
+      in >> command;
+
+      std::string reply;
+      if(command == "position") reply = handlePosition(engine, in);
+      else if(command == "go") reply = handleGo(engine, in);
+      else if(command == "quit") break;
+      else reply = "error unknown command " + command;
+
+      if(!conn.sendLine(reply)) break;
+    }
+    conn.shutdown();
+  }
+}